@@ -0,0 +1,175 @@
+/*
+* asset_loader.c - Background loading of fonts and images
+*
+* Everything the game knows it will need is loaded on a thread of its own
+* at startup, so no screen has to wait for a PNG to be decoded or asciified
+* on its first frame. Render functions poll the handle of the image they
+* want and draw without it until it's ready.
+*/
+
+#define ASSET_IMAGES_MAX	16
+
+// Fonts and background images loaded at startup, in order. Images are
+// asciified with the font the background views draw them with.
+typedef struct {
+	char *filename;
+	u32 charWidth;
+	u32 charHeight;
+	bool colorize;		// as the consoles drawing with it are
+} KnownFont;
+
+global_variable KnownFont knownFonts[] = {
+	{"./terminal16x16.png", 16, 16, true},
+	{"./graphic16x16.png", 16, 16, false},
+};
+
+global_variable char *knownImages[] = {
+	"./launch.png",
+	"./scrollBackground.png",
+	"./gameover.png",
+	"./you_won.png",
+};
+
+#define KNOWN_IMAGE_FONT		"./terminal16x16.png"
+#define KNOWN_IMAGE_CELL_SIZE	16
+
+// A background image and its ascii version, which may still be loading
+typedef struct {
+	char *filename;
+	BitmapImage *image;
+	AsciiImage *asciiImage;
+	SDL_atomic_t ready;		// set once image and asciiImage can be used
+} ImageAsset;
+
+typedef struct {
+	SDL_Thread *thread;
+	SDL_atomic_t cancel;
+	ImageAsset images[ASSET_IMAGES_MAX];
+	u32 imageCount;
+	SDL_atomic_t readyCount;
+	u32 readyCountSeen;		// main thread only, for asset_loader_poll
+} AssetLoader;
+
+global_variable AssetLoader assetLoader = {0};
+
+
+internal int
+asset_loader_thread(void *data)
+{
+	(void)data;
+
+	// Fonts are held on to for good, so they stay loaded for the consoles
+	// that will want them
+	u32 fontCount = sizeof(knownFonts) / sizeof(KnownFont);
+	for (u32 i = 0; i < fontCount; i++) {
+		KnownFont *kf = &knownFonts[i];
+		font_acquire(kf->filename, 0, kf->charWidth, kf->charHeight, kf->colorize);
+	}
+
+	// A console is only needed for its font and cell size
+	Console *console = console_new(KNOWN_IMAGE_CELL_SIZE, KNOWN_IMAGE_CELL_SIZE, 1, 1,
+								   0x000000ff, true, NULL, 0);
+	console_set_bitmap_font(console, KNOWN_IMAGE_FONT, 0,
+							KNOWN_IMAGE_CELL_SIZE, KNOWN_IMAGE_CELL_SIZE);
+
+	for (u32 i = 0; i < assetLoader.imageCount; i++) {
+		if (SDL_AtomicGet(&assetLoader.cancel)) {
+			break;
+		}
+		ImageAsset *asset = &assetLoader.images[i];
+		asset->image = image_load_from_file(asset->filename);
+		asset->asciiImage = asciify_bitmap(console, asset->image);
+		SDL_AtomicSet(&asset->ready, 1);
+		SDL_AtomicAdd(&assetLoader.readyCount, 1);
+	}
+
+	console_destroy(console);
+	return 0;
+}
+
+/*
+Starts loading every known font and image in the background.
+*/
+internal void
+asset_loader_start()
+{
+	u32 imageCount = sizeof(knownImages) / sizeof(char *);
+	assert(imageCount <= ASSET_IMAGES_MAX);
+	for (u32 i = 0; i < imageCount; i++) {
+		assetLoader.images[i].filename = knownImages[i];
+	}
+	assetLoader.imageCount = imageCount;
+
+	// The registry has to exist before the loader thread starts sharing it
+	font_registry_init();
+	assetLoader.thread = SDL_CreateThread(asset_loader_thread, "assets", NULL);
+	if (assetLoader.thread == NULL) {
+		// No thread to be had, so load everything up front instead
+		asset_loader_thread(NULL);
+	}
+}
+
+/*
+Blocks until everything has finished loading.
+*/
+internal void
+asset_loader_wait()
+{
+	if (assetLoader.thread != NULL) {
+		SDL_WaitThread(assetLoader.thread, NULL);
+		assetLoader.thread = NULL;
+	}
+}
+
+internal void
+asset_loader_shutdown()
+{
+	// Let the image being worked on finish, and skip the rest
+	SDL_AtomicSet(&assetLoader.cancel, 1);
+	asset_loader_wait();
+}
+
+internal bool
+asset_loader_busy()
+{
+	return (assetLoader.thread != NULL) &&
+		   ((u32)SDL_AtomicGet(&assetLoader.readyCount) < assetLoader.imageCount);
+}
+
+/*
+Returns true if any image has finished loading since the last call, meaning
+views waiting on it need to be drawn again.
+*/
+internal bool
+asset_loader_poll()
+{
+	u32 readyCount = (u32)SDL_AtomicGet(&assetLoader.readyCount);
+	if (readyCount == assetLoader.readyCountSeen) {
+		return false;
+	}
+	assetLoader.readyCountSeen = readyCount;
+	return true;
+}
+
+/*
+Returns the handle for one of the known images. It can't be used until
+asset_image_ready says so.
+*/
+internal ImageAsset *
+asset_image(char *filename)
+{
+	for (u32 i = 0; i < assetLoader.imageCount; i++) {
+		if (strcmp(assetLoader.images[i].filename, filename) == 0) {
+			return &assetLoader.images[i];
+		}
+	}
+
+	assert(!"Images have to be listed in knownImages to be loaded");
+	return NULL;
+}
+
+internal bool
+asset_image_ready(ImageAsset *asset)
+{
+	return SDL_AtomicGet(&asset->ready) != 0;
+}
@@ -0,0 +1,203 @@
+/*
+* bench.c - Headless rendering benchmark
+*
+* Runs the real render path - view render functions, console rasterizing
+* and compositing into the framebuffer - over a handful of scripted worst
+* case screens, and writes how fast each one went out as JSON. Run it with
+* `make bench-render`, and compare the numbers before and after changing
+* anything in blending, caching or threading.
+*/
+
+#define BENCH_SEED				1		// every run plays out on the same map
+#define BENCH_WARMUP_FRAMES		10		// let the tile caches fill before timing
+
+// Defined in dark.c
+internal void render_screen(UIScreen *screen);
+
+typedef void (*BenchFunction)(u32 frame);
+
+typedef struct {
+	char *name;
+	BenchFunction setup;	// puts the screen in place, once
+	BenchFunction step;		// changes whatever the scenario changes, every frame
+} BenchScenario;
+
+typedef struct {
+	u32 frames;
+	double seconds;
+	u64 cellCount;
+	u64 pixelCount;
+} BenchResult;
+
+
+internal void
+bench_damage_screen()
+{
+	// Everything on screen has to be rasterized again, as after a screen change
+	UIRect fullRect = {0, 0, framebuffer.width, framebuffer.height};
+	ui_damage(&fullRect);
+}
+
+internal void
+bench_start_game()
+{
+	if (!currentlyInGame) {
+		game_new();
+		currentlyInGame = true;
+	}
+	ui_set_active_screen(screen_show_in_game());
+	hide_inventory_overlay();
+}
+
+internal void
+bench_setup_map_explored(u32 frame)
+{
+	(void)frame;
+	bench_start_game();
+
+	// Everything has been seen, and is lit, so every object gets drawn
+	Visibility *visibilities = (Visibility *)component_array(COMP_VISIBILITY);
+	for (u32 i = 0; i < component_count(COMP_VISIBILITY); i++) {
+		visibilities[i].hasBeenSeen = true;
+	}
+	for (u32 x = 0; x < MAP_WIDTH; x++) {
+		for (u32 y = 0; y < MAP_HEIGHT; y++) {
+			fovMap[x][y] = 1;
+			levelTerrain[x][y].flags |= TILE_SEEN;
+		}
+	}
+}
+
+internal void
+bench_setup_inventory(u32 frame)
+{
+	bench_setup_map_explored(frame);
+	show_inventory_overlay();
+}
+
+internal void
+bench_setup_message_log(u32 frame)
+{
+	(void)frame;
+	bench_start_game();
+}
+
+internal void
+bench_step_message_log(u32 frame)
+{
+	// A message every frame, as in a big fight, with nothing else changing
+	char *msg = frame_string("Frame %u: The Giant Rat hits you for %u damage, and you miss it.",
+							 frame, frame % 10);
+	add_message(msg, (frame & 1) ? 0xFF0000FF : 0xCCCCCCFF);
+}
+
+internal void
+bench_setup_launch(u32 frame)
+{
+	(void)frame;
+	currentlyInGame = false;
+	ui_set_active_screen(screen_show_launch());
+}
+
+internal void
+bench_step_damage(u32 frame)
+{
+	(void)frame;
+	bench_damage_screen();
+}
+
+global_variable BenchScenario benchScenarios[] = {
+	{"map_explored",	bench_setup_map_explored,	bench_step_damage},
+	{"inventory",		bench_setup_inventory,		bench_step_damage},
+	{"message_log",		bench_setup_message_log,	bench_step_message_log},
+	{"launch_ascii",	bench_setup_launch,			bench_step_damage},
+};
+
+internal BenchResult
+bench_run_scenario(BenchScenario *scenario, u32 frameCount)
+{
+	scenario->setup(0);
+	for (u32 i = 0; i < BENCH_WARMUP_FRAMES; i++) {
+		scenario->step(i);
+		render_screen(ui_get_active_screen());
+		ui_framebuffer_clear_damage();
+	}
+
+	rasterStats.cellCount = 0;
+	rasterStats.pixelCount = 0;
+	u64 start = SDL_GetPerformanceCounter();
+	for (u32 i = 0; i < frameCount; i++) {
+		scenario->step(BENCH_WARMUP_FRAMES + i);
+		render_screen(ui_get_active_screen());
+
+		// Nothing is presented, but the damage would have been uploaded by now
+		ui_framebuffer_clear_damage();
+	}
+	u64 elapsed = SDL_GetPerformanceCounter() - start;
+
+	BenchResult result;
+	result.frames = frameCount;
+	result.seconds = (double)elapsed / SDL_GetPerformanceFrequency();
+	result.cellCount = rasterStats.cellCount;
+	result.pixelCount = rasterStats.pixelCount;
+	return result;
+}
+
+/*
+Runs every scenario for frameCount frames, and writes the results to
+filename as JSON. Expects the framebuffer to be set up, and the fonts and
+images loaded.
+*/
+internal bool
+bench_render(char *filename, u32 frameCount)
+{
+	FILE *fp = fopen(filename, "w");
+	if (fp == NULL) {
+		printf("Could not write %s\n", filename);
+		return false;
+	}
+
+	if (frameCount == 0) {
+		frameCount = 1;
+	}
+
+	// The launch screen is benchmarked asciified
+	asciiMode = true;
+	srand(BENCH_SEED);
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"threads\": %u,\n", worker_pool_thread_count());
+	fprintf(fp, "  \"width\": %u,\n", framebuffer.width);
+	fprintf(fp, "  \"height\": %u,\n", framebuffer.height);
+	fprintf(fp, "  \"scenarios\": [\n");
+
+	u32 scenarioCount = sizeof(benchScenarios) / sizeof(BenchScenario);
+	for (u32 i = 0; i < scenarioCount; i++) {
+		BenchScenario *scenario = &benchScenarios[i];
+		BenchResult result = bench_run_scenario(scenario, frameCount);
+
+		double fps = result.frames / result.seconds;
+		double nsPerCell = (result.cellCount > 0) ? (result.seconds * 1e9) / result.cellCount : 0.0;
+		double pixelsPerSecond = result.pixelCount / result.seconds;
+
+		fprintf(fp, "    {\n");
+		fprintf(fp, "      \"name\": \"%s\",\n", scenario->name);
+		fprintf(fp, "      \"frames\": %u,\n", result.frames);
+		fprintf(fp, "      \"seconds\": %.6f,\n", result.seconds);
+		fprintf(fp, "      \"fps\": %.1f,\n", fps);
+		fprintf(fp, "      \"cells_per_frame\": %.1f,\n", (double)result.cellCount / result.frames);
+		fprintf(fp, "      \"ns_per_cell\": %.1f,\n", nsPerCell);
+		fprintf(fp, "      \"blended_px_per_sec\": %.0f\n", pixelsPerSecond);
+		fprintf(fp, "    }%s\n", (i + 1 < scenarioCount) ? "," : "");
+
+		printf("%-14s %8.1f fps %8.1f ns/cell %8.1f Mpx/s\n", scenario->name,
+			   fps, nsPerCell, pixelsPerSecond / 1e6);
+	}
+
+	fprintf(fp, "  ]\n");
+	fprintf(fp, "}\n");
+	fclose(fp);
+
+	printf("Wrote %s\n", filename);
+	return true;
+}
@@ -15,4 +15,6 @@ cl %INCLUDE_DIRS% %OPTS% %DEBUG% dark.c
 
 link %LIB_DIRS% %LINKER_OPTS% dark.obj %LIBS%
 
+dark.exe --build-pack assets.pak
+
 del *.obj
\ No newline at end of file
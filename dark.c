@@ -15,13 +15,25 @@
 #define NUM_COLS		80
 #define NUM_ROWS 		45
 
-#define FPS_LIMIT		20
+// Length of one animation tick, in ms. Frames are only drawn when something 
+// changes - on input, or when an animation reaches a keyframe.
+#define TICK_MS			50
+
+// Prebuilt fonts and images, made with --build-pack. Loaded from the PNGs 
+// when it's missing or out of date.
+#define ASSET_PACK_FILE	"./assets.pak"
+
+// Threads used to rasterize views: 0 = one per CPU core, 1 = serial
+#ifndef RENDER_THREADS
+#define RENDER_THREADS	0
+#endif
 
 
 #include <stdbool.h>
 #include <stdint.h>
 
 typedef uint8_t		u8;
+typedef uint16_t	u16;
 typedef uint32_t	u32;
 typedef uint64_t	u64;
 typedef int8_t		i8;
@@ -38,14 +50,22 @@ void quit_game();
 
 #include "util.c"
 #include "String.c"
+#include "frame_arena.c"
 #include "list.c"
+#include "worker_pool.c"
+#include "perf.c"
+#include "pack.c"
 #include "config.c"
 // #define HASHMAP_IMPLEMENTATION
 // #include "hashmap.h"
 #include "ui.c"
+#include "asset_loader.c"
+#include "term.c"
 #include "map.c"
 #include "game.c"
 #include "fov.c"
+#include "spatial.c"
+#include "perf_overlay.c"
 
 // Screen files
 #include "screen_in_game.c"
@@ -54,26 +74,230 @@ void quit_game();
 #include "screen_end_game.c"
 #include "screen_win_game.c"
 
+#include "bench.c"
+
+
+// Command line options
+typedef struct {
+	bool headless;			// render into the framebuffer only, no window
+	bool terminal;			// draw to this terminal with ANSI escapes, no window
+	u32 frameCount;			// headless: frames to render before quitting
+	char *keys;				// headless: comma separated key names, one fed per frame
+	char *dumpPrefix;		// headless: write frames to <prefix>_<frame>.ppm/.png
+	u32 dumpEvery;			// headless: dump every n frames, 0 = last frame only
+	bool dumpPng;
+	char *buildPack;		// write the asset pack to this file, then quit
+	char *benchRender;		// write rendering benchmark results to this file, then quit
+	bool selfTest;			// run the DEBUG conformance checks, then quit
+} Options;
+
+global_variable Options options = {0};
+
+
+internal void
+parse_options(int argc, char *argv[])
+{
+	options.frameCount = 60;
+	for (i32 i = 1; i < argc; i++) {
+		char *arg = argv[i];
+		bool hasValue = (i + 1 < argc);
+		if (strcmp(arg, "--headless") == 0) {
+			options.headless = true;
+		} else if (strcmp(arg, "--terminal") == 0) {
+			options.terminal = true;
+		} else if ((strcmp(arg, "--frames") == 0) && hasValue) {
+			options.frameCount = atoi(argv[++i]);
+		} else if ((strcmp(arg, "--keys") == 0) && hasValue) {
+			options.keys = argv[++i];
+		} else if ((strcmp(arg, "--dump") == 0) && hasValue) {
+			options.dumpPrefix = argv[++i];
+		} else if ((strcmp(arg, "--dump-every") == 0) && hasValue) {
+			options.dumpEvery = atoi(argv[++i]);
+		} else if (strcmp(arg, "--png") == 0) {
+			options.dumpPng = true;
+		} else if ((strcmp(arg, "--build-pack") == 0) && hasValue) {
+			options.buildPack = argv[++i];
+		} else if ((strcmp(arg, "--bench-render") == 0) && hasValue) {
+			options.benchRender = argv[++i];
+			options.headless = true;
+		} else if (strcmp(arg, "--self-test") == 0) {
+			options.selfTest = true;
+		} else {
+			printf("Unknown option: %s\n", arg);
+			printf("Usage: dark [--terminal] [--headless [--frames n] [--keys k1,k2,...] [--dump prefix [--dump-every n] [--png]]]\n");
+			printf("       dark --build-pack file\n");
+			printf("       dark --bench-render file [--frames n]\n");
+			printf("       dark --self-test\n");
+			exit(1);
+		}
+	}
+}
+
+internal void
+headless_feed_key(u32 frame)
+{
+	// Push the frame'th key from the --keys list, as if it was pressed
+	if (options.keys == NULL) { return; }
+
+	char *keyName = options.keys;
+	for (u32 i = 0; i < frame; i++) {
+		keyName = strchr(keyName, ',');
+		if (keyName == NULL) { return; }
+		keyName += 1;
+	}
+
+	char name[32] = {0};
+	u32 length = strcspn(keyName, ",");
+	if (length >= sizeof(name)) { length = sizeof(name) - 1; }
+	memcpy(name, keyName, length);
+
+	SDL_Event event = {0};
+	event.type = SDL_KEYDOWN;
+	event.key.state = SDL_PRESSED;
+	event.key.keysym.sym = SDL_GetKeyFromName(name);
+	if (event.key.keysym.sym != SDLK_UNKNOWN) {
+		SDL_PushEvent(&event);
+	}
+}
+
+internal void
+headless_dump_frame(u32 frame)
+{
+	char *filename = String_Create("%s_%05d.%s", options.dumpPrefix, frame, 
+								   options.dumpPng ? "png" : "ppm");
+	bool written = options.dumpPng ? ui_framebuffer_write_png(filename) : 
+									 ui_framebuffer_write_ppm(filename);
+	if (!written) {
+		printf("Could not write %s\n", filename);
+	}
+	String_Destroy(filename);
+}
+
+/*
+Writes the known fonts and images, and the images asciified, to an asset pack.
+*/
+internal bool
+build_asset_pack(char *filename)
+{
+	AssetPackWriter *writer = asset_pack_writer_new();
+	bool ok = true;
+
+	u32 fontCount = sizeof(knownFonts) / sizeof(KnownFont);
+	for (u32 i = 0; ok && (i < fontCount); i++) {
+		KnownFont *pf = &knownFonts[i];
+		ConsoleFont *font = font_acquire(pf->filename, 0, pf->charWidth, pf->charHeight, pf->colorize);
+		u32 pixelCount = font->atlasWidth * font->atlasHeight;
+		if (pf->colorize) {
+			ok = asset_pack_writer_add(writer, ASSET_FONT_COVERAGE, pf->filename, NULL, 
+									   pf->charWidth, pf->charHeight, font->atlasWidth, font->atlasHeight, 
+									   font->coverage, pixelCount * sizeof(u8));
+		} else {
+			ok = asset_pack_writer_add(writer, ASSET_FONT_ATLAS, pf->filename, NULL, 
+									   pf->charWidth, pf->charHeight, font->atlasWidth, font->atlasHeight, 
+									   font->atlas, pixelCount * sizeof(u32));
+		}
+	}
+
+	// A console is only needed for its font and cell size
+	Console *console = console_new(SCREEN_WIDTH, SCREEN_HEIGHT, NUM_ROWS, NUM_COLS, 
+								   0x000000ff, true, NULL, 0);
+	console_set_bitmap_font(console, KNOWN_IMAGE_FONT, 0, 
+							KNOWN_IMAGE_CELL_SIZE, KNOWN_IMAGE_CELL_SIZE);
+
+	u32 imageCount = sizeof(knownImages) / sizeof(char *);
+	for (u32 i = 0; ok && (i < imageCount); i++) {
+		BitmapImage *image = image_load_from_file(knownImages[i]);
+		AsciiImage *asciiImage = asciify_bitmap(console, image);
+		ok = asset_pack_writer_add(writer, ASSET_BITMAP, knownImages[i], NULL, 0, 0, 
+								   image->width, image->height, 
+								   image->pixels, image->width * image->height * sizeof(u32)) &&
+			 asset_pack_writer_add(writer, ASSET_ASCII_IMAGE, knownImages[i], KNOWN_IMAGE_FONT, 
+								   console->cellWidth, console->cellHeight, 
+								   asciiImage->cols, asciiImage->rows, 
+								   asciiImage->cells, asciiImage->rows * asciiImage->cols * sizeof(ConsoleCell));
+	}
+
+	ok = ok && asset_pack_writer_save(writer, filename);
+	if (ok) {
+		printf("Wrote %u assets to %s\n", writer->entryCount, filename);
+	} else {
+		printf("Failed to build asset pack %s\n", filename);
+	}
+
+	asset_pack_writer_destroy(writer);
+	return ok;
+}
+
+internal bool
+self_test()
+{
+#ifdef DEBUG
+	// Fast paths checked against their slow, obviously right references
+	bool passed = ui_blend_self_test();
+
+	// The spatial queries against a brute force scan, over a level generated 
+	// from a fixed seed, so a failure can be reproduced
+	srand(1);
+	game_new();
+	passed = self_test_report("spatial queries", spatial_conformance_check()) && passed;
+
+	printf(passed ? "All self tests passed\n" : "Self tests FAILED\n");
+	return passed;
+#else
+	printf("Self tests are only built into DEBUG builds - try make check\n");
+	return false;
+#endif
+}
 
 internal void 
-render_screen(SDL_Renderer *renderer, 
-				  SDL_Texture *screenTexture, 
-				  UIScreen *screen) 
+render_screen(UIScreen *screen) 
 {
 
-	// Render views from back to front for the current screen
+	// Render views from back to front for the current screen, straight 
+	// into the framebuffer
 	ListElement *e = list_head(screen->views);
+	u32 viewIndex = 0;
 	while (e != NULL) {
 		UIView *v = (UIView *)list_data(e);
-		console_clear(v->console);
-		v->render(v->console);
-		SDL_UpdateTexture(screenTexture, v->pixelRect, v->console->pixels, v->pixelRect->w * sizeof(u32));
+		if (v->hidden) {
+			e = list_next(e);
+			viewIndex += 1;
+			continue;
+		}
+		if (!v->onDemand || v->dirty) {
+			PERF_BEGIN(PERF_RENDER);
+			PERF_VIEW_BEGIN();
+			console_clear(v->console);
+			v->render(v->console);
+			v->dirty = false;
+			PERF_VIEW_END(viewIndex);
+			PERF_END(PERF_RENDER);
+		}
+		// The terminal backend works from the cells, so skip the pixels
+		if (!options.terminal) {
+			ui_composite_view(v);
+		}
 		e = list_next(e);
+		viewIndex += 1;
 	}
 
+	// Whatever text the views formatted has been drawn into their consoles
+	frame_arena_reset();
+}
+
+internal void 
+present_screen(SDL_Renderer *renderer, SDL_Texture *screenTexture) 
+{
+	// Only the part of the screen that changed goes up to the texture
+	PERF_BEGIN(PERF_UPLOAD);
+	ui_framebuffer_present(screenTexture);
+	PERF_END(PERF_UPLOAD);
+
+	PERF_BEGIN(PERF_PRESENT);
 	SDL_RenderClear(renderer);
 	SDL_RenderCopy(renderer, screenTexture, NULL, NULL);
 	SDL_RenderPresent(renderer);
+	PERF_END(PERF_PRESENT);
 }
 
 global_variable bool gameIsRunning = true;
@@ -81,93 +305,281 @@ void quit_game() {
 	gameIsRunning = false;
 }
 
-int main() 
+internal void
+handle_event(SDL_Event event)
+{
+	if (event.type == SDL_QUIT) {
+		quit_game(); 
+		return;
+	}
+
+	// The window may need repainting after being uncovered or resized
+	if (event.type == SDL_WINDOWEVENT) {
+		ui_request_redraw();
+		return;
+	}
+
+	// Handle "global" keypresses (those not handled on a screen-by-screen basis)
+	if (event.type == SDL_KEYDOWN) {
+		SDL_Keycode key = event.key.keysym.sym;
+
+		switch (key) {
+			case SDLK_t: {
+				asciiMode = !asciiMode;
+				if (currentlyInGame) {
+					in_game_use_tileset();
+				}
+			}
+			break;
+
+			// // DEBUG - jump straight to win screen
+			case SDLK_w: {
+				ui_set_active_screen(screen_show_win_game());
+			}
+			break;
+
+#if PERF_OVERLAY
+			case SDLK_F3: {
+				perf_overlay_toggle(ui_get_active_screen());
+			}
+			break;
+#endif
+
+			default:
+				break;
+		}
+	
+		// Send the event to the currently active screen for handling
+		UIScreen *screenForInput = ui_get_active_screen(); 
+		screenForInput->handle_event(screenForInput, event);
+
+		// Any key press can change what's on screen
+		ui_request_redraw();
+	}
+}
+
+int main(int argc, char *argv[]) 
 {
 	srand((unsigned)time(NULL));
 
-	SDL_Init(SDL_INIT_VIDEO);
+	parse_options(argc, argv);
+
+	// Headless, terminal, pack building and self test runs never open a window, so they 
+	// don't need SDL's video subsystem at all
+	if (options.headless || options.terminal || (options.buildPack != NULL) || options.selfTest) {
+		SDL_Init(SDL_INIT_EVENTS | SDL_INIT_TIMER);
+	} else {
+		SDL_Init(SDL_INIT_VIDEO);
+	}
+	ui_blend_init();
+
+	if (options.selfTest) {
+		bool passed = self_test();
+		SDL_Quit();
+		return passed ? 0 : 1;
+	}
+
+	worker_pool_init(RENDER_THREADS);
 
-	SDL_Window *window = SDL_CreateWindow("Dark Caverns",
-		SDL_WINDOWPOS_UNDEFINED, 
-		SDL_WINDOWPOS_UNDEFINED,
-		SCREEN_WIDTH, SCREEN_HEIGHT,
-		0);
+	// Building the pack must read the source PNGs, not an old pack
+	if (options.buildPack != NULL) {
+		bool built = build_asset_pack(options.buildPack);
+		worker_pool_shutdown();
+		SDL_Quit();
+		return built ? 0 : 1;
+	}
+	asset_pack_open(ASSET_PACK_FILE);
 
-	SDL_Renderer *renderer = SDL_CreateRenderer(window, 0, SDL_RENDERER_SOFTWARE);
+	// Headless runs wait for everything to load, so their frames are repeatable
+	asset_loader_start();
+	if (options.headless) {
+		asset_loader_wait();
+	}
 
-	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
-	SDL_RenderSetLogicalSize(renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
+	SDL_Window *window = NULL;
+	SDL_Renderer *renderer = NULL;
+	SDL_Texture *screenTexture = NULL;
+	if (options.terminal) {
+		// Bitmap backdrops don't translate to a terminal, so stick to ASCII
+		asciiMode = true;
+		if (!term_init()) {
+			SDL_Quit();
+			return 1;
+		}
+	} else if (!options.headless) {
+		window = SDL_CreateWindow("Dark Caverns",
+			SDL_WINDOWPOS_UNDEFINED, 
+			SDL_WINDOWPOS_UNDEFINED,
+			SCREEN_WIDTH, SCREEN_HEIGHT,
+			0);
+
+		renderer = SDL_CreateRenderer(window, 0, SDL_RENDERER_SOFTWARE);
+
+		SDL_RenderSetLogicalSize(renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+		// If the window is a whole multiple of our resolution, there's nothing 
+		// for linear filtering to smooth out, so use the cheaper nearest scaling
+		i32 outputWidth, outputHeight;
+		SDL_GetRendererOutputSize(renderer, &outputWidth, &outputHeight);
+		bool integerScale = ((outputWidth % SCREEN_WIDTH) == 0) && 
+							((outputHeight % SCREEN_HEIGHT) == 0) &&
+							((outputWidth / SCREEN_WIDTH) == (outputHeight / SCREEN_HEIGHT));
+		SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, integerScale ? "nearest" : "linear");
+
+		screenTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
+	}
 
-	SDL_Texture *screenTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
+	ui_framebuffer_init(SCREEN_WIDTH, SCREEN_HEIGHT);
+
+	if (options.benchRender != NULL) {
+		bool benchmarked = bench_render(options.benchRender, options.frameCount);
+		asset_loader_shutdown();
+		worker_pool_shutdown();
+		SDL_Quit();
+		asset_pack_close();
+		return benchmarked ? 0 : 1;
+	}
 
 	// Initialize UI state to show launch screen
 	ui_set_active_screen(screen_show_launch());
 
 	currentlyInGame = false;
 
+	u32 frame = 0;
+	u64 headlessStart = SDL_GetPerformanceCounter();
+	u32 lastTickTime = SDL_GetTicks();
+
 	while (gameIsRunning) {
 		playerTookTurn = false;
 
+		// Sleep until there's input, or until the next animation keyframe 
+		// is due. Headless runs never wait - they feed themselves input.
 		SDL_Event event;
-		u32 timePerFrame = 1000 / FPS_LIMIT;
-		u32 frameStart = 0;
-		while (SDL_PollEvent(&event) != 0) {
+		bool haveEvent = false;
+		if (options.headless) {
+			headless_feed_key(frame);
+			haveEvent = SDL_PollEvent(&event);
+		} else {
+			i32 timeout = -1;
+			if (currentlyInGame) {
+				i32 ticksUntilKeyframe = animation_ticks_until_keyframe();
+				if (ticksUntilKeyframe >= 0) {
+					timeout = (lastTickTime + (ticksUntilKeyframe * TICK_MS)) - SDL_GetTicks();
+					if (timeout < 0) { timeout = 0; }
+				}
+			}
+			if (asset_loader_busy() && ((timeout < 0) || (timeout > TICK_MS))) {
+				// Check back regularly for images that have finished loading
+				timeout = TICK_MS;
+			}
+			if (options.terminal) {
+				term_wait_for_input(timeout);
+				haveEvent = SDL_PollEvent(&event);
+			} else {
+				haveEvent = SDL_WaitEventTimeout(&event, timeout);
+			}
+		}
+
+		PERF_FRAME_BEGIN();
+		u32 now = SDL_GetTicks();
+		if (!currentlyInGame || (animation_ticks_until_keyframe() < 0)) {
+			// Nothing was animating while we slept, so there's nothing to catch 
+			// up on - animations started by this frame's input count from now
+			lastTickTime = now;
+		}
 
-			frameStart = SDL_GetTicks();
+		// Redraw views that have been waiting on an image to load
+		if (asset_loader_poll()) {
+			ui_request_redraw();
+		}
 
-			if (event.type == SDL_QUIT) {
-				quit_game(); 
+		// Handle the event we woke up for, and anything else queued up
+		while (haveEvent) {
+			handle_event(event);
+			if (!gameIsRunning) {
 				break;
 			}
+			haveEvent = SDL_PollEvent(&event);
+		}
 
-			// Handle "global" keypresses (those not handled on a screen-by-screen basis)
-			if (event.type == SDL_KEYDOWN) {
-				SDL_Keycode key = event.key.keysym.sym;
-
-				switch (key) {
-					case SDLK_t: {
-						asciiMode = !asciiMode;
-						if (currentlyInGame) {
-							ui_set_active_screen(screen_show_in_game());
-						}
-					}
-					break;
-
-					// // DEBUG - jump straight to win screen
-					case SDLK_w: {
-						ui_set_active_screen(screen_show_win_game());
-					}
-					break;
-
-					default:
-						break;
+		// If we're in-game, have the game update itself, and advance 
+		// animations by however many ticks have gone by
+		if (currentlyInGame) {
+			PERF_BEGIN(PERF_GAME_UPDATE);
+			game_update();
+			PERF_END(PERF_GAME_UPDATE);
+
+			u32 elapsedTicks = (now - lastTickTime) / TICK_MS;
+			if (options.headless) {
+				elapsedTicks = 1;
+			}
+			if (elapsedTicks > 0) {
+				lastTickTime += elapsedTicks * TICK_MS;
+				PERF_BEGIN(PERF_ANIMATION);
+				u32 keyframeCount = animation_update(elapsedTicks);
+				PERF_END(PERF_ANIMATION);
+				if (keyframeCount > 0) {
+					ui_request_redraw();
 				}
-			
-				// Send the event to the currently active screen for handling
-				UIScreen *screenForInput = ui_get_active_screen(); 
-				screenForInput->handle_event(screenForInput, event);
 			}
 		}
 
-		// If we're in-game, have the game update itself
-		if (currentlyInGame) {
-			game_update();		
+		// Render the active screen, but only if something changed
+		if (!redrawRequested && !options.headless) {
+			continue;
 		}
+		redrawRequested = false;
+#if PERF_OVERLAY
+		perf_overlay_follow(ui_get_active_screen());
+#endif
+		render_screen(ui_get_active_screen());
+		frame += 1;
+
+		if (options.headless) {
+			PERF_FRAME_END();
+
+			// Run flat out, dumping frames as asked, until we've done enough
+			bool lastFrame = (frame >= options.frameCount) || !gameIsRunning;
+			if ((options.dumpPrefix != NULL) && 
+				(lastFrame || ((options.dumpEvery > 0) && ((frame % options.dumpEvery) == 0)))) {
+				headless_dump_frame(frame);
+			}
 
-		// Render the active screen
-		render_screen(renderer, screenTexture, ui_get_active_screen());
+			// Nothing is presented, but the damage would have been uploaded by now
+			ui_framebuffer_clear_damage();
+			if (lastFrame) {
+				quit_game();
+			}
+			continue;
+		}
 
-		// Limit our FPS
-		i32 sleepTime = timePerFrame - (SDL_GetTicks() - frameStart);
-		if (sleepTime > 0) {
-			SDL_Delay(sleepTime);
+		if (options.terminal) {
+			PERF_BEGIN(PERF_PRESENT);
+			term_present(ui_get_active_screen());
+			PERF_END(PERF_PRESENT);
+			if (playerTookTurn) {
+				term_end_turn();
+			}
+		} else {
+			present_screen(renderer, screenTexture);
 		}
+		PERF_FRAME_END();
 	}
 
-	SDL_DestroyRenderer(renderer);
-	SDL_DestroyWindow(window);
+	if (options.headless) {
+		double seconds = (double)(SDL_GetPerformanceCounter() - headlessStart) / SDL_GetPerformanceFrequency();
+		printf("Rendered %u frames in %.3fs (%.1f fps)\n", frame, seconds, frame / seconds);
+	}
+
+	asset_loader_shutdown();
+	worker_pool_shutdown();
+	term_shutdown();
+
+	if (renderer) { SDL_DestroyRenderer(renderer); }
+	if (window) { SDL_DestroyWindow(window); }
 
 	SDL_Quit();
+	asset_pack_close();
 
 	return 0;
 }
@@ -104,19 +104,17 @@ void add_shadow(Shadow s) {
 }
 
 bool cell_blocks_sight(u32 x, u32 y) {
-	List *gos = game_objects_at_position(x, y);
-	if (gos != NULL) {
-		ListElement *e = list_head(gos);
-		while (e != NULL) {
-			GameObject *go = (GameObject *)list_data(e);
-			if (go->id != UNUSED) {
-				Physical *phys = (Physical *)game_object_get_component(go, COMP_PHYSICAL);
-				if (phys->blocksSight) {
-					return true;
-				}
-			}
-			e = list_next(e);
+	if (terrain_blocks(x, y, TILE_BLOCKS_SIGHT)) {
+		return true;
+	}
+
+	GameObject *go = game_objects_at_position(x, y);
+	while (go != NULL) {
+		Physical *phys = (Physical *)game_object_get_component(go, COMP_PHYSICAL);
+		if ((phys != NULL) && phys->blocksSight) {
+			return true;
 		}
+		go = game_object_next_at_position(go);
 	}
 
 	return false;
@@ -0,0 +1,59 @@
+/*
+* frame_arena.c - Scratch memory that only lasts until the end of the frame
+*
+* Render functions format their text every time they're drawn. Rather than
+* allocating (and having to remember to free) a string for each piece, they
+* take it from here, and it's all thrown away at once when render_screen is
+* done. Only the main thread renders, so the arena isn't locked.
+*/
+
+#include <stdarg.h>
+
+#define FRAME_ARENA_SIZE	(64 * 1024)
+
+typedef struct {
+	u8 memory[FRAME_ARENA_SIZE];
+	u32 used;
+} FrameArena;
+
+global_variable FrameArena frameArena = {0};
+
+
+/*
+Formats a string into the frame arena, as String_Create would, but with
+nothing to free.
+*/
+internal char *
+frame_string(const char *format, ...)
+{
+	u32 start = frameArena.used;
+	if (start >= FRAME_ARENA_SIZE) {
+		assert(!"Frame arena is full");
+		return "";
+	}
+
+	// Format straight into the free space, in a single pass
+	char *str = (char *)&frameArena.memory[start];
+	u32 available = FRAME_ARENA_SIZE - start;
+	va_list args;
+	va_start(args, format);
+	i32 len = vsnprintf(str, available, format, args);
+	va_end(args);
+
+	if ((len < 0) || ((u32)len >= available)) {
+		assert(!"Frame arena is full");
+		return "";
+	}
+
+	frameArena.used = start + len + 1;
+	return str;
+}
+
+/*
+Lets go of everything taken from the arena this frame.
+*/
+internal void
+frame_arena_reset()
+{
+	frameArena.used = 0;
+}
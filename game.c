@@ -2,53 +2,77 @@
 * game.c
 */
 
+#include <stddef.h>
 #include <time.h>
 
-#define UNUSED	-1
-
 #define LAYER_UNSET		0
 #define LAYER_GROUND	1
 #define LAYER_MID		2
 #define LAYER_AIR		3
 #define LAYER_TOP		4
+#define LAYER_COUNT		LAYER_TOP
 
 #define MONSTER_TYPE_COUNT	100
 #define ITEM_TYPE_COUNT		100
 #define MAX_DUNGEON_LEVEL	20
 #define GEMS_PER_LEVEL		5
 
+// Every kind of component, and the struct holding it. Component storage, and 
+// copying components in and out of it, is all generated from this table.
+#define GAME_COMPONENTS(X) \
+	X(COMP_POSITION,	Position) \
+	X(COMP_VISIBILITY,	Visibility) \
+	X(COMP_PHYSICAL,	Physical) \
+	X(COMP_HEALTH,		Health) \
+	X(COMP_MOVEMENT,	Movement) \
+	X(COMP_COMBAT,		Combat) \
+	X(COMP_EQUIPMENT,	Equipment) \
+	X(COMP_TREASURE,	Treasure) \
+	X(COMP_ANIMATION,	Animation)
+
+#define COMPONENT_ENUM(id, type)	id,
+
 typedef enum {
-	COMP_POSITION = 0,
-	COMP_VISIBILITY,
-	COMP_PHYSICAL,
-	COMP_HEALTH,
-	COMP_MOVEMENT,
-	COMP_COMBAT,
-	COMP_EQUIPMENT,
-	COMP_TREASURE,
-	COMP_ANIMATION, 
-
-	/* Define other components above here */
+	GAME_COMPONENTS(COMPONENT_ENUM)
 	COMPONENT_COUNT
 } GameComponentType;
 
 
 /* Entity */
-typedef struct {
-	i32 id;
-	void *components[COMPONENT_COUNT];
+
+// Objects are referred to by handle: the index of their slot in the entity 
+// table, and the generation of that slot, which changes every time it's 
+// freed. A handle kept after its object is destroyed never finds another.
+typedef u32 EntityHandle;
+
+#define ENTITY_INDEX_BITS		20
+#define ENTITY_INDEX_MASK		((1u << ENTITY_INDEX_BITS) - 1)
+#define ENTITY_GENERATION_MASK	((1u << (32 - ENTITY_INDEX_BITS)) - 1)
+#define ENTITY_NONE				0		// never handed out - generations start at 1
+
+#define COMPONENT_NONE	0xffffffff
+
+typedef struct GameObject {
+	EntityHandle id;					// ENTITY_NONE while the slot is free
+	u32 components[COMPONENT_COUNT];	// index into each component's store, or COMPONENT_NONE
+	u32 generation;
+	u32 nextFree;						// next free slot, while this one is free
+
+	// The other objects in the same map cell, while this one has a Position
+	struct GameObject *cellNext;
+	struct GameObject *cellPrev;
 } GameObject;
 
 
 /* Components */
 typedef struct {
-	i32 objectId;
+	EntityHandle objectId;
 	u8 x, y;	
 	u8 layer;				// 1 is bottom layer
 } Position;
 
 typedef struct {
-	i32 objectId;
+	EntityHandle objectId;
 	asciiChar glyph;
 	u32 fgColor;
 	u32 bgColor;
@@ -58,13 +82,13 @@ typedef struct {
 } Visibility;
 
 typedef struct {
-	i32 objectId;
+	EntityHandle objectId;
 	bool blocksMovement;
 	bool blocksSight;
 } Physical;
 
 typedef struct {
-	i32 objectId;
+	EntityHandle objectId;
 	i32 speed;				// How many spaces the object can move when it moves.
 	i32 frequency;			// How often the object moves. 1=every tick, 2=every other tick, etc.
 	i32 ticksUntilNextMove;	// Countdown to next move. Moves when = 0.
@@ -75,7 +99,7 @@ typedef struct {
 } Movement;
 
 typedef struct {
-	i32 objectId;
+	EntityHandle objectId;
 	i32 currentHP;
 	i32 maxHP;
 	i32 recoveryRate;		// HP recovered per tick.
@@ -83,7 +107,7 @@ typedef struct {
 } Health;
 
 typedef struct {
-	i32 objectId;
+	EntityHandle objectId;
 	i32 toHit;				// chance to hit
 	i32 toHitModifier;
 	i32 attack;				// attack = damage inflicted per hit
@@ -93,7 +117,7 @@ typedef struct {
 } Combat;
 
 typedef struct {
-	i32 objectId;
+	EntityHandle objectId;
 	i32 quantity;
 	i32 weight;
 	i32 lifetime;			// turns until equipment degrades beyond use.
@@ -102,24 +126,90 @@ typedef struct {
 } Equipment;
 
 typedef struct {
-	i32 objectId;
+	EntityHandle objectId;
 	i32 value;
 } Treasure;
 
 typedef struct {
-	i32 objectId;
+	EntityHandle objectId;
 	i32 keyFrameInterval;
 	i32 ticksUntilKeyframe;
 	bool finished;
-	void (*keyframeAnimation)(u32);
+	void (*keyframeAnimation)(EntityHandle);
 	u32 value1;
 } Animation;
 
+/* Component Storage */
+
+// Each kind of component is kept packed in one array, in no particular order. 
+// Objects know the index of each of theirs, and the store knows the owner of 
+// each component, so removing one just moves the last into its place.
+typedef struct {
+	u8 *data;
+	EntityHandle *owners;		// object of each component
+	u32 count;
+	u32 capacity;
+} ComponentStore;
+
+typedef struct {
+	u32 size;
+	u32 objectIdOffset;
+} ComponentInfo;
+
+#define COMPONENT_INFO(id, type)	{sizeof(type), offsetof(type, objectId)},
+
+global_variable ComponentInfo componentInfo[COMPONENT_COUNT] = {
+	GAME_COMPONENTS(COMPONENT_INFO)
+};
+
+#define COMPONENT_STORE_MIN_CAPACITY	64
+
+
+/* Terrain */
+
+// Walls and floors aren't game objects. Each level lays out a grid of tiles, 
+// and everything about a kind of tile is kept once, in tileDefinitions.
+typedef enum {
+	TERRAIN_NONE,		// nothing laid out here
+	TERRAIN_FLOOR,
+	TERRAIN_WALL,
+	TERRAIN_TYPE_COUNT
+} TerrainType;
+
+#define TILE_BLOCKS_MOVEMENT	0x01
+#define TILE_BLOCKS_SIGHT		0x02
+#define TILE_SEEN				0x04
+
+typedef struct {
+	asciiChar glyph;
+	u32 fgColor;
+	u32 bgColor;
+	u8 blocking;		// TILE_BLOCKS_ bits
+	char *name;
+} TileDefinition;
+
+typedef struct {
+	u8 type;			// TerrainType
+	u8 flags;			// its definition's blocking bits, plus TILE_SEEN once the player has seen it
+} Tile;
+
+
+/* Render Index */
+
+// What the map view draws in a single cell, on top of its terrain - the 
+// object on top in each layer, from LAYER_GROUND up, for when the cell is in 
+// view, and the topmost one in each layer that has been seen and is remembered 
+// out of view. Only objects with a Visibility are indexed.
+typedef struct {
+	GameObject *layers[LAYER_COUNT];
+	GameObject *remembered[LAYER_COUNT];
+} CellRenderIndex;
+
+
 /* Level Support */
 
 typedef struct {
 	i32 level;
-	bool (*mapWalls)[MAP_HEIGHT];
 } DungeonLevel;
 
 
@@ -139,22 +229,30 @@ typedef struct {
 } HOFRecord;
 
 
+/* Entity Table */
+
+// Slots are allocated a page at a time and never move, so GameObject 
+// pointers stay good for as long as the object lives
+#define ENTITY_PAGE_SIZE	1024
+#define ENTITY_PAGES_MAX	((ENTITY_INDEX_MASK + 1) / ENTITY_PAGE_SIZE)
+#define ENTITY_FREE_NONE	0xffffffff
+
+typedef struct {
+	GameObject *pages[ENTITY_PAGES_MAX];
+	u32 pageCount;
+	u32 slotsUsed;		// slots that have ever been handed out
+	u32 freeHead;		// most recently freed slot
+	u32 liveCount;
+} EntityTable;
+
+
 /* Game State */
-#define MAX_GO 	10000
 #define EQUIP_LIFETIME 500
 
 global_variable GameObject *player = NULL;
 global_variable char* playerName = NULL;
-global_variable GameObject gameObjects[MAX_GO];
-global_variable List *positionComps;
-global_variable List *visibilityComps;
-global_variable List *physicalComps;
-global_variable List *movementComps;
-global_variable List *healthComps;
-global_variable List *combatComps;
-global_variable List *equipmentComps;
-global_variable List *treasureComps;
-global_variable List *animationComps;
+global_variable EntityTable entityTable = {.freeHead = ENTITY_FREE_NONE};
+global_variable ComponentStore componentStores[COMPONENT_COUNT];
 
 global_variable List *carriedItems;
 global_variable i32 maxWeightAllowed = 20;
@@ -170,7 +268,15 @@ global_variable	i32 currentLevelNumber;
 global_variable DungeonLevel *currentLevel;
 global_variable u32 fovMap[MAP_WIDTH][MAP_HEIGHT];
 global_variable i32 (*targetMap)[MAP_HEIGHT] = NULL;
-global_variable List *goPositions[MAP_WIDTH][MAP_HEIGHT];
+global_variable GameObject *cellObjects[MAP_WIDTH][MAP_HEIGHT];		// the object that arrived in each cell last
+global_variable u8 movementBlockers[MAP_WIDTH][MAP_HEIGHT];		// objects in each cell that block movement
+global_variable CellRenderIndex renderIndex[MAP_HEIGHT][MAP_WIDTH];		// row-major, like console cells
+global_variable Tile levelTerrain[MAP_WIDTH][MAP_HEIGHT];		// the current level's walls and floors
+global_variable TileDefinition tileDefinitions[TERRAIN_TYPE_COUNT] = {
+	{0,   0x00000000, 0x00000000, 0,											"Nothing"},
+	{'.', 0x3e3c3cFF, 0x00000000, 0,											"Floor"},
+	{'#', 0x675644FF, 0x00000000, (TILE_BLOCKS_MOVEMENT | TILE_BLOCKS_SIGHT),	"Wall"},
+};
 global_variable Config *monsterConfig = NULL;
 global_variable i32 monsterProbability[MONSTER_TYPE_COUNT][MAX_DUNGEON_LEVEL];		// TODO: dynamically size this based on actual count of monsters in config file
 global_variable Config *itemConfig = NULL;
@@ -192,7 +298,9 @@ internal UIScreen * screen_show_endgame();
 internal UIScreen * screen_show_win_game();
 internal void game_over();
 void item_toggle_equip(GameObject *item);
-void animateGem(u32 gameObjectId);
+void animateGem(EntityHandle gameObjectId);
+internal void in_game_mark_stats_dirty();
+internal void in_game_mark_log_dirty();
 
 
 /* World State Management */
@@ -266,23 +374,53 @@ void get_max_counts(ConfigEntity *entity, char *propertyName, i32 *maxCounts) {
 	free(copy);
 }
 
+internal GameObject *
+entity_slot(u32 index) {
+	return &entityTable.pages[index / ENTITY_PAGE_SIZE][index % ENTITY_PAGE_SIZE];
+}
+
+/*
+Returns the object a handle refers to, or NULL if it has been destroyed.
+*/
+GameObject *game_object_get(EntityHandle handle) {
+	u32 index = handle & ENTITY_INDEX_MASK;
+	if ((handle == ENTITY_NONE) || (index >= entityTable.slotsUsed)) {
+		return NULL;
+	}
+	GameObject *go = entity_slot(index);
+	return (go->id == handle) ? go : NULL;
+}
+
+internal void
+entity_table_clear() {
+	// Free every slot, so handles from before don't find anything after
+	for (u32 i = 0; i < entityTable.slotsUsed; i++) {
+		GameObject *go = entity_slot(i);
+		if (go->id != ENTITY_NONE) {
+			go->id = ENTITY_NONE;
+			go->generation = (go->generation % ENTITY_GENERATION_MASK) + 1;
+		}
+		go->nextFree = (i + 1 < entityTable.slotsUsed) ? (i + 1) : ENTITY_FREE_NONE;
+	}
+	entityTable.freeHead = (entityTable.slotsUsed > 0) ? 0 : ENTITY_FREE_NONE;
+	entityTable.liveCount = 0;
+}
+
 void world_state_init() {
-	for (u32 i = 0; i < MAX_GO; i++) {
-		gameObjects[i].id = UNUSED;
-	}
-	positionComps = list_new(free);
-	visibilityComps = list_new(free);
-	physicalComps = list_new(free);
-	movementComps = list_new(free);
-	healthComps = list_new(free);
-	combatComps = list_new(free);
-	equipmentComps = list_new(free);
-	treasureComps = list_new(free);
-	animationComps = list_new(free);
+	entity_table_clear();
+	for (u32 c = 0; c < COMPONENT_COUNT; c++) {
+		componentStores[c].count = 0;
+	}
 
 	carriedItems = list_new(free);
 	gemsFoundTotal = 0;
 
+	// Forget where the last game's objects were
+	memset(cellObjects, 0, sizeof(cellObjects));
+	memset(renderIndex, 0, sizeof(renderIndex));
+	memset(movementBlockers, 0, sizeof(movementBlockers));
+	memset(levelTerrain, 0, sizeof(levelTerrain));
+
 	// Parse necessary config files into memory
 	monsterConfig = config_file_parse("monsters.cfg");
 	itemConfig = config_file_parse("items.cfg");
@@ -316,413 +454,330 @@ void world_state_init() {
 /* Game Object Management */
 
 GameObject *game_object_create() {
-	// Find the next available object space
-	GameObject *go = NULL;
-	for (i32 i = 0; i < MAX_GO; i++) {
-		if (gameObjects[i].id == UNUSED) {
-			go = &gameObjects[i];
-			go->id = i;
-			break;
+	// Reuse the most recently freed slot, or take a new one
+	u32 index;
+	if (entityTable.freeHead != ENTITY_FREE_NONE) {
+		index = entityTable.freeHead;
+		entityTable.freeHead = entity_slot(index)->nextFree;
+	} else {
+		if (entityTable.slotsUsed == (entityTable.pageCount * ENTITY_PAGE_SIZE)) {
+			assert(entityTable.pageCount < ENTITY_PAGES_MAX);
+			GameObject *page = calloc(ENTITY_PAGE_SIZE, sizeof(GameObject));
+			for (u32 i = 0; i < ENTITY_PAGE_SIZE; i++) {
+				page[i].generation = 1;
+			}
+			entityTable.pages[entityTable.pageCount] = page;
+			entityTable.pageCount += 1;
 		}
+		index = entityTable.slotsUsed;
+		entityTable.slotsUsed += 1;
 	}
 
-	assert(go != NULL);		// Have we run out of game objects?
+	GameObject *go = entity_slot(index);
+	go->id = (go->generation << ENTITY_INDEX_BITS) | index;
+	go->nextFree = ENTITY_FREE_NONE;
+	go->cellNext = NULL;
+	go->cellPrev = NULL;
+	entityTable.liveCount += 1;
 
 	for (i32 i = 0; i < COMPONENT_COUNT; i++) {
-		go->components[i] = NULL;
+		go->components[i] = COMPONENT_NONE;
 	}
 
 	return go;
 }
 
-void game_object_update_component(GameObject *obj, 
-							  GameComponentType comp,
-							  void *compData) {
-	assert(obj->id != UNUSED);
+void *game_object_get_component(GameObject *obj, 
+								GameComponentType comp) {
+	u32 index = obj->components[comp];
+	if (index == COMPONENT_NONE) {
+		return NULL;
+	}
+	return &componentStores[comp].data[index * componentInfo[comp].size];
+}
 
-	switch (comp) {
-		case COMP_POSITION: {
-			if (compData != NULL) {
-				Position *pos = obj->components[COMP_POSITION];
-				bool addedNew = false;
-				if (pos == NULL) {
-					pos = (Position *)calloc(1, sizeof(Position));
-					addedNew = true;
-				} else {
-					// Remove game obj from the position helper DS
-					List *ls = goPositions[pos->x][pos->y];
-					list_remove_element_with_data(ls, obj);
-				}
-				Position *posData = (Position *)compData;
-				pos->objectId = obj->id;
-				pos->x = posData->x;
-				pos->y = posData->y;
-				pos->layer = posData->layer;
-
-				// Only insert into world component list if we just allocated a new component
-				if (addedNew) {
-					list_insert_after(positionComps, NULL, pos);					
-				}
-	
-				obj->components[comp] = pos;
+/*
+The components of one kind, packed, for systems to run through. Adding or 
+removing a component of that kind moves them around.
+*/
+void *component_array(GameComponentType comp) {
+	return componentStores[comp].data;
+}
 
-				// Update our helper DS 
-				List *gos = goPositions[posData->x][posData->y];
-				if (gos == NULL) {
-					gos = list_new(free);
-					goPositions[posData->x][posData->y] = gos;
-				}
-				list_insert_after(gos, NULL, obj);
+u32 component_count(GameComponentType comp) {
+	return componentStores[comp].count;
+}
 
-			} else {
-				// Clear component 
-				Position *pos = obj->components[COMP_POSITION];
-				if (pos != NULL) {
-					list_remove_element_with_data(positionComps, pos);	
-				}
-				obj->components[comp] = NULL;
+internal void *
+component_add(GameObject *obj, GameComponentType comp) {
+	ComponentStore *store = &componentStores[comp];
+	u32 size = componentInfo[comp].size;
+	if (store->count == store->capacity) {
+		store->capacity = (store->capacity > 0) ? (store->capacity * 2) : COMPONENT_STORE_MIN_CAPACITY;
+		store->data = realloc(store->data, store->capacity * size);
+		store->owners = realloc(store->owners, store->capacity * sizeof(EntityHandle));
+	}
 
-				// Remove game obj from the position helper DS
-				List *ls = goPositions[pos->x][pos->y];
-				list_remove_element_with_data(ls, obj);
-			}
+	u32 index = store->count;
+	store->count += 1;
+	store->owners[index] = obj->id;
+	obj->components[comp] = index;
 
-			break;
-		}
+	void *data = &store->data[index * size];
+	memset(data, 0, size);
+	return data;
+}
 
-		case COMP_VISIBILITY: {
-			if (compData != NULL) {
-				Visibility *vis = obj->components[COMP_VISIBILITY];
-				bool addedNew = false;
-				if (vis == NULL)  {
-					vis = (Visibility *)calloc(1, sizeof(Visibility));
-					addedNew = true;
-				}
-				Visibility *visData = (Visibility *)compData;
-				vis->objectId = obj->id;
-				vis->glyph = visData->glyph;
-				vis->fgColor = visData->fgColor;
-				vis->bgColor = visData->bgColor;
-				vis->hasBeenSeen = visData->hasBeenSeen;
-				vis->visibleOutsideFOV = visData->visibleOutsideFOV;
-				if (visData->name != NULL) {
-					vis->name = calloc(strlen(visData->name) + 1, sizeof(char));
-					strcpy(vis->name, visData->name);
-				}
+internal void
+component_remove(GameObject *obj, GameComponentType comp) {
+	u32 index = obj->components[comp];
+	if (index == COMPONENT_NONE) {
+		return;
+	}
 
-				if (addedNew) {
-					list_insert_after(visibilityComps, NULL, vis);					
-				}
-	
-				obj->components[comp] = vis;
+	// Fill the hole with the last component, and tell its owner where it went
+	ComponentStore *store = &componentStores[comp];
+	u32 size = componentInfo[comp].size;
+	u32 last = store->count - 1;
+	if (index != last) {
+		memcpy(&store->data[index * size], &store->data[last * size], size);
+		store->owners[index] = store->owners[last];
+		game_object_get(store->owners[index])->components[comp] = index;
+	}
+	store->count = last;
+	obj->components[comp] = COMPONENT_NONE;
+}
 
-			} else {
-				// Clear component 
-				Visibility *vis = obj->components[COMP_VISIBILITY];
-				if (vis != NULL) {
-					list_remove_element_with_data(visibilityComps, vis);				
-				}
-				obj->components[comp] = NULL;
+/*
+Rebuilds the render index for a single cell from the objects there. The 
+object that arrived in the cell most recently is on top of its layer.
+*/
+void render_index_update_cell(u32 x, u32 y) {
+	CellRenderIndex *cell = &renderIndex[y][x];
+	memset(cell->layers, 0, sizeof(cell->layers));
+	memset(cell->remembered, 0, sizeof(cell->remembered));
+
+	// Objects are linked in at the head of their cell's chain as they arrive
+	GameObject *go = cellObjects[x][y];
+	while (go != NULL) {
+		Position *p = (Position *)game_object_get_component(go, COMP_POSITION);
+		Visibility *vis = (Visibility *)game_object_get_component(go, COMP_VISIBILITY);
+		if ((p != NULL) && (vis != NULL)) {
+			if (cell->layers[p->layer - 1] == NULL) {
+				cell->layers[p->layer - 1] = go;
 			}
+			if ((cell->remembered[p->layer - 1] == NULL) && vis->visibleOutsideFOV && vis->hasBeenSeen) {
+				cell->remembered[p->layer - 1] = go;
+			}
+		}
+		go = go->cellNext;
+	}
+}
 
-			break;
+/*
+Marks every object in a cell that's in view as seen, not just the ones on 
+top, and updates the cell's render index if that gives it something new to 
+remember.
+*/
+void render_index_mark_cell_seen(u32 x, u32 y) {
+	bool rememberedChanged = false;
+	for (GameObject *go = cellObjects[x][y]; go != NULL; go = go->cellNext) {
+		Visibility *vis = (Visibility *)game_object_get_component(go, COMP_VISIBILITY);
+		if ((vis != NULL) && !vis->hasBeenSeen) {
+			vis->hasBeenSeen = true;
+			rememberedChanged = rememberedChanged || vis->visibleOutsideFOV;
 		}
+	}
+	if (rememberedChanged) {
+		render_index_update_cell(x, y);
+	}
+}
 
-		case COMP_PHYSICAL: {
-			if (compData != NULL) {
-				Physical *phys = obj->components[COMP_PHYSICAL];
-				bool addedNew = false;
-				if (phys == NULL) {
-					phys = (Physical *)calloc(1, sizeof(Physical));
-					addedNew = true;
-				}
-				Physical *physData = (Physical *)compData;
-				phys->objectId = obj->id;
-				phys->blocksSight = physData->blocksSight;
-				phys->blocksMovement = physData->blocksMovement;
+/*
+Links the object in at the head of the chain of objects in its cell, or 
+unlinks it. Neither allocates, or walks the chain.
+*/
+internal void
+cell_link(GameObject *obj, u8 x, u8 y) {
+	obj->cellPrev = NULL;
+	obj->cellNext = cellObjects[x][y];
+	if (obj->cellNext != NULL) {
+		obj->cellNext->cellPrev = obj;
+	}
+	cellObjects[x][y] = obj;
+}
 
-				if (addedNew) {
-					list_insert_after(physicalComps, NULL, phys);					
-				}
-				obj->components[comp] = phys;
+internal void
+cell_unlink(GameObject *obj, u8 x, u8 y) {
+	if (obj->cellPrev != NULL) {
+		obj->cellPrev->cellNext = obj->cellNext;
+	} else {
+		cellObjects[x][y] = obj->cellNext;
+	}
+	if (obj->cellNext != NULL) {
+		obj->cellNext->cellPrev = obj->cellPrev;
+	}
+	obj->cellNext = NULL;
+	obj->cellPrev = NULL;
+}
 
-			} else {
-				// Clear component 
-				Physical *phys = obj->components[COMP_PHYSICAL];
-				if (phys != NULL) {
-					list_remove_element_with_data(physicalComps, phys);				
-				}
-				obj->components[comp] = NULL;
-			}
+/*
+Adds delta to the blocker count of the object's cell, if it's on the map and 
+blocks movement. Called with -1 before its Position or Physical changes, and 
++1 after, so the counts always match what's there.
+*/
+void movement_blockers_add(GameObject *obj, i32 delta) {
+	Position *p = (Position *)game_object_get_component(obj, COMP_POSITION);
+	Physical *phys = (Physical *)game_object_get_component(obj, COMP_PHYSICAL);
+	if ((p != NULL) && (phys != NULL) && phys->blocksMovement) {
+		movementBlockers[p->x][p->y] += delta;
+	}
+}
 
-			break;
+void game_object_update_component(GameObject *obj, 
+							  GameComponentType comp,
+							  void *compData) {
+	assert(game_object_get(obj->id) == obj);
+
+	// Take the object out of the map's indexes while what they're built 
+	// from changes
+	bool onMap = false;
+	u8 oldX = 0, oldY = 0;
+	if ((comp == COMP_POSITION) || (comp == COMP_PHYSICAL)) {
+		movement_blockers_add(obj, -1);
+	}
+	if (comp == COMP_POSITION) {
+		Position *oldPos = (Position *)game_object_get_component(obj, COMP_POSITION);
+		if (oldPos != NULL) {
+			cell_unlink(obj, oldPos->x, oldPos->y);
+			onMap = true;
+			oldX = oldPos->x;
+			oldY = oldPos->y;
 		}
+	}
 
-		case COMP_MOVEMENT: {
-			if (compData != NULL) {
-				Movement *mv = obj->components[COMP_MOVEMENT];
-				bool addedNew = false;
-				if (mv == NULL) {
-					mv = (Movement *)calloc(1, sizeof(Movement));
-					addedNew = true;
-				}
-				Movement *mvData = (Movement *)compData;
-				mv->objectId = obj->id;
-				mv->speed = mvData->speed;
-				mv->frequency = mvData->frequency;
-				mv->ticksUntilNextMove = mvData->ticksUntilNextMove;
-				mv->chasingPlayer = mvData->chasingPlayer;
-				mv->turnsSincePlayerSeen = mvData->turnsSincePlayerSeen;
-
-				if (addedNew) {
-					list_insert_after(movementComps, NULL, mv);				
-				}
-				obj->components[comp] = mv;
-
-			} else {
-				// Clear component 
-				Movement *mv = obj->components[COMP_MOVEMENT];
-				if (mv != NULL) {
-					list_remove_element_with_data(movementComps, mv);				
-				}
-				obj->components[comp] = NULL;				
-			}
-
-			break;
+	if (compData != NULL) {
+		void *data = game_object_get_component(obj, comp);
+		if (data == NULL) {
+			data = component_add(obj, comp);
 		}
+		memmove(data, compData, componentInfo[comp].size);
+		*(EntityHandle *)((u8 *)data + componentInfo[comp].objectIdOffset) = obj->id;
+	} else {
+		component_remove(obj, comp);
+	}
 
-		case COMP_HEALTH: {
-			if (compData != NULL) {
-				Health *hlth = obj->components[COMP_HEALTH];
-				bool addedNew = false;
-				if (hlth == NULL) {
-					hlth = (Health *)calloc(1, sizeof(Health));
-					addedNew = true;
-				}
-				Health *hlthData = (Health *)compData;
-				hlth->objectId = obj->id;
-				hlth->currentHP = hlthData->currentHP;
-				hlth->maxHP = hlthData->maxHP;
-				hlth->recoveryRate = hlthData->recoveryRate;
-				hlth->ticksUntilRemoval = hlthData->ticksUntilRemoval;
-
-				if (addedNew) {
-					list_insert_after(healthComps, NULL, hlth);				
-				}
-				obj->components[comp] = hlth;
-
-			} else {
-				// Clear component 
-				Health *h = obj->components[COMP_HEALTH];
-				if (h != NULL) {
-					list_remove_element_with_data(healthComps, h);				
-				}
-				obj->components[comp] = NULL;				
+	// Then bring everything kept alongside the components up to date
+	switch (comp) {
+		case COMP_POSITION: {
+			Position *pos = (Position *)game_object_get_component(obj, COMP_POSITION);
+			if (onMap && ((pos == NULL) || (oldX != pos->x) || (oldY != pos->y))) {
+				render_index_update_cell(oldX, oldY);
 			}
-
-			break;
-		}
-
-		case COMP_COMBAT: {
-			if (compData != NULL) {
-				Combat *com = obj->components[COMP_COMBAT];
-				bool addedNew = false;
-				if (com == NULL) {
-					com = (Combat *)calloc(1, sizeof(Combat));
-					addedNew = true;
-				}
-				Combat *combatData = (Combat *)compData;
-				com->objectId = obj->id;
-				com->toHit = combatData->toHit;
-				com->toHitModifier = combatData->toHitModifier;
-				com->attack = combatData->attack;
-				com->defense = combatData->defense;
-				com->attackModifier = combatData->attackModifier;
-				com->defenseModifier = combatData->defenseModifier;
-
-				if (addedNew) {
-					list_insert_after(combatComps, NULL, com);				
-				}
-				obj->components[comp] = com;
-				
-			} else {
-				// Clear component 
-				Combat *c = obj->components[COMP_COMBAT];
-				if (c != NULL) {
-					list_remove_element_with_data(combatComps, c);				
-				}
-				obj->components[comp] = NULL;				
+			if (pos != NULL) {
+				cell_link(obj, pos->x, pos->y);
+				render_index_update_cell(pos->x, pos->y);
 			}
-
+			movement_blockers_add(obj, 1);
 			break;
 		}
 
-		case COMP_EQUIPMENT: {
-			if (compData != NULL) {
-				Equipment *equip = obj->components[COMP_EQUIPMENT];
-				bool addedNew = false;
-				if (equip == NULL) {
-					equip = (Equipment *)calloc(1, sizeof(Equipment));
-					addedNew = true;
-				}
-
-				Equipment *equipData = (Equipment *)compData;
-				equip->objectId = obj->id;
-				equip->quantity = equipData->quantity;
-				equip->weight = equipData->weight;
-				equip->lifetime = equipData->lifetime;
-				if (equipData->slot != NULL) {
-					equip->slot = calloc(strlen(equipData->slot) + 1, sizeof(char));
-					strcpy(equip->slot, equipData->slot);
-				}
-				equip->isEquipped = equipData->isEquipped;
-
-				if (addedNew) {
-					list_insert_after(equipmentComps, NULL, equip);				
-				}
-				obj->components[comp] = equip;
-				
-			} else {
-				// Clear component 
-				Equipment *e = obj->components[COMP_EQUIPMENT];
-				if (e != NULL) {
-					list_remove_element_with_data(equipmentComps, e);				
-				}
-				obj->components[comp] = NULL;				
+		case COMP_VISIBILITY: {
+			Visibility *vis = (Visibility *)game_object_get_component(obj, COMP_VISIBILITY);
+			if ((vis != NULL) && (vis->name != NULL)) {
+				char *name = vis->name;
+				vis->name = calloc(strlen(name) + 1, sizeof(char));
+				strcpy(vis->name, name);
 			}
 
+			// The object may have just appeared in, or vanished from, its cell
+			Position *visPos = (Position *)game_object_get_component(obj, COMP_POSITION);
+			if (visPos != NULL) {
+				render_index_update_cell(visPos->x, visPos->y);
+			}
 			break;
 		}
 
-		case COMP_TREASURE: {
-			if (compData != NULL) {
-				Treasure *treas = obj->components[COMP_TREASURE];
-				bool addedNew = false;
-				if (treas == NULL) {
-					treas = (Treasure *)calloc(1, sizeof(Treasure));
-					addedNew = true;
-				}
-
-				Treasure *treasData = (Treasure *)compData;
-				treas->objectId = obj->id;
-				treas->value = treasData->value;
-
-				if (addedNew) {
-					list_insert_after(treasureComps, NULL, treas);				
-				}
-				obj->components[comp] = treas;
-				
-			} else {
-				// Clear component 
-				Treasure *t = obj->components[COMP_TREASURE];
-				if (t != NULL) {
-					list_remove_element_with_data(treasureComps, t);				
-				}
-				obj->components[comp] = NULL;				
-			}
-
+		case COMP_PHYSICAL: {
+			movement_blockers_add(obj, 1);
 			break;
 		}
 
-		case COMP_ANIMATION: {
-			if (compData != NULL) {
-				Animation *anim = obj->components[COMP_ANIMATION];
-				bool addedNew = false;
-				if (anim == NULL) {
-					anim = (Animation *)calloc(1, sizeof(Animation));
-					addedNew = true;
-				}
-
-				Animation *animData = (Animation *)compData;
-				anim->objectId = obj->id;
-				anim->keyFrameInterval = animData->keyFrameInterval;
-				anim->ticksUntilKeyframe = animData->ticksUntilKeyframe;
-				anim->finished = animData->finished;
-				anim->keyframeAnimation = animData->keyframeAnimation;
-				anim->value1 = animData->value1;
-
-				if (addedNew) {
-					list_insert_after(animationComps, NULL, anim);				
-				}
-				obj->components[comp] = anim;
-				
-			} else {
-				// Clear component 
-				Animation *a = obj->components[COMP_ANIMATION];
-				if (a != NULL) {
-					list_remove_element_with_data(animationComps, a);				
-				}
-				obj->components[comp] = NULL;				
+		case COMP_EQUIPMENT: {
+			Equipment *equip = (Equipment *)game_object_get_component(obj, COMP_EQUIPMENT);
+			if ((equip != NULL) && (equip->slot != NULL)) {
+				char *slot = equip->slot;
+				equip->slot = calloc(strlen(slot) + 1, sizeof(char));
+				strcpy(equip->slot, slot);
 			}
-
 			break;
 		}
 
 		default:
-			assert(1 == 0);
+			break;
 	}
-
 }
 
 void game_object_destroy(GameObject *obj) {
-	ListElement *elementToRemove = list_search(positionComps, obj->components[COMP_POSITION]);
-	if (elementToRemove != NULL ) { list_remove(positionComps, elementToRemove); }
-
-	elementToRemove = list_search(visibilityComps, obj->components[COMP_VISIBILITY]);
-	if (elementToRemove != NULL ) { list_remove(visibilityComps, elementToRemove); }
-
-	elementToRemove = list_search(physicalComps, obj->components[COMP_PHYSICAL]);
-	if (elementToRemove != NULL ) { list_remove(physicalComps, elementToRemove); }
-
-	elementToRemove = list_search(movementComps, obj->components[COMP_MOVEMENT]);
-	if (elementToRemove != NULL ) { list_remove(movementComps, elementToRemove); }
-
-	elementToRemove = list_search(healthComps, obj->components[COMP_HEALTH]);
-	if (elementToRemove != NULL ) { list_remove(healthComps, elementToRemove); }
-
-	elementToRemove = list_search(combatComps, obj->components[COMP_COMBAT]);
-	if (elementToRemove != NULL ) { list_remove(combatComps, elementToRemove); }
+	// Take it off the map first, while we still know where it is
+	movement_blockers_add(obj, -1);
+	Position *pos = (Position *)game_object_get_component(obj, COMP_POSITION);
+	bool onMap = (pos != NULL);
+	u8 x = 0, y = 0;
+	if (onMap) {
+		x = pos->x;
+		y = pos->y;
+		cell_unlink(obj, x, y);
+	}
 
-	elementToRemove = list_search(equipmentComps, obj->components[COMP_EQUIPMENT]);
-	if (elementToRemove != NULL ) { list_remove(equipmentComps, elementToRemove); }
+	for (u32 c = 0; c < COMPONENT_COUNT; c++) {
+		component_remove(obj, c);
+	}
 
-	elementToRemove = list_search(treasureComps, obj->components[COMP_TREASURE]);
-	if (elementToRemove != NULL ) { list_remove(treasureComps, elementToRemove); }
+	// Give the slot back, and make sure no handle to the object finds it again
+	u32 index = obj->id & ENTITY_INDEX_MASK;
+	obj->id = ENTITY_NONE;
+	obj->generation = (obj->generation % ENTITY_GENERATION_MASK) + 1;
+	obj->nextFree = entityTable.freeHead;
+	entityTable.freeHead = index;
+	entityTable.liveCount -= 1;
 
-	elementToRemove = list_search(animationComps, obj->components[COMP_ANIMATION]);
-	if (elementToRemove != NULL ) { list_remove(animationComps, elementToRemove); }
+	if (onMap) {
+		render_index_update_cell(x, y);
+	}
+}
 
-	// TODO: Clean up other components used by this object
+/*
+Returns the first of the objects at x, y, or NULL if there are none. Walk 
+the rest with game_object_next_at_position - the most recent arrival comes 
+first.
+*/
+GameObject *game_objects_at_position(u32 x, u32 y) {
+	return cellObjects[x][y];
+}
 
-	obj->id = UNUSED;
-	for (i32 i = 0; i < COMPONENT_COUNT; i++) {
-		obj->components[i] = NULL;
-	}
+GameObject *game_object_next_at_position(GameObject *obj) {
+	return obj->cellNext;
 }
 
 
-void *game_object_get_component(GameObject *obj, 
-								GameComponentType comp) {
-	return obj->components[comp];
+/* Terrain */
+
+void terrain_set(u8 x, u8 y, TerrainType type) {
+	levelTerrain[x][y].type = type;
+	levelTerrain[x][y].flags = tileDefinitions[type].blocking;
 }
 
-List *game_objects_at_position(u32 x, u32 y) {
-	return goPositions[x][y];
+/*
+Returns true if the terrain at x, y has any of the given TILE_BLOCKS_ bits.
+*/
+bool terrain_blocks(u32 x, u32 y, u8 blocking) {
+	return (levelTerrain[x][y].flags & blocking) != 0;
 }
 
 
 /* Game objects */
 
-void floor_add(u8 x, u8 y) {
-	GameObject *floor = game_object_create();
-	Position floorPos = {.objectId = floor->id, .x = x, .y = y, .layer = LAYER_GROUND};
-	game_object_update_component(floor, COMP_POSITION, &floorPos);
-	Visibility floorVis = {.objectId = floor->id, .glyph = '.', .fgColor = 0x3e3c3cFF, .bgColor = 0x00000000, .visibleOutsideFOV = true, .name="Floor"};
-	game_object_update_component(floor, COMP_VISIBILITY, &floorVis);
-	Physical floorPhys = {.objectId = floor->id, .blocksMovement = false, .blocksSight = false};
-	game_object_update_component(floor, COMP_PHYSICAL, &floorPhys);
-}
-
 void item_add(char *name, u8 x, u8 y, u8 layer, asciiChar glyph, u32 fgColor, 
 	i32 hitMod, i32 attMod, i32 defMod, i32 quantity, i32 weight, char *slot) {
 
@@ -759,37 +814,26 @@ void npc_add(char *name, u8 x, u8 y, u8 layer, asciiChar glyph, u32 fgColor,
 	game_object_update_component(npc, COMP_COMBAT, &com);
 }
 
-void wall_add(u8 x, u8 y) {
-	GameObject *wall = game_object_create();
-	Position wallPos = {.objectId = wall->id, .x = x, .y = y, .layer = LAYER_GROUND};
-	game_object_update_component(wall, COMP_POSITION, &wallPos);
-	Visibility wallVis = {wall->id, '#', 0x675644FF, 0x00000000, .visibleOutsideFOV = true, .name="Wall"};
-	game_object_update_component(wall, COMP_VISIBILITY, &wallVis);
-	Physical wallPhys = {wall->id, true, true};
-	game_object_update_component(wall, COMP_PHYSICAL, &wallPhys);
-}
-
 
 /* Level Management */
 
-Point level_get_open_point(bool (*mapCells)[MAP_HEIGHT]) {
+Point level_get_open_point() {
 	// Return a random position within the level that is open
 	for (;;) {
 		u32 x = rand() % MAP_WIDTH;
 		u32 y = rand() % MAP_HEIGHT;
-		if (mapCells[x][y] == false) {
+		if (!terrain_blocks(x, y, TILE_BLOCKS_MOVEMENT)) {
 			bool isOccupied = false;
-			List *objs = game_objects_at_position(x, y);
-			ListElement *le = list_head(objs);
-			while (le != NULL) {
-				Equipment *eq = (Equipment *)game_object_get_component(le->data, COMP_EQUIPMENT);
-				Health *h = (Health *)game_object_get_component(le->data, COMP_HEALTH);
-				Treasure *t = (Treasure *)game_object_get_component(le->data, COMP_TREASURE);
+			GameObject *go = game_objects_at_position(x, y);
+			while (go != NULL) {
+				Equipment *eq = (Equipment *)game_object_get_component(go, COMP_EQUIPMENT);
+				Health *h = (Health *)game_object_get_component(go, COMP_HEALTH);
+				Treasure *t = (Treasure *)game_object_get_component(go, COMP_TREASURE);
 				if ((eq != NULL) || (h != NULL) || (t != NULL)) { 
 					isOccupied = true;
 					break; 
 				}
-				le = list_next(le);
+				go = game_object_next_at_position(go);
 			}
 			if (!isOccupied) {
 				return (Point) {x, y};
@@ -840,13 +884,14 @@ ConfigEntity * get_entity_with_id(Config *config, i32 id) {
 
 DungeonLevel * level_init(i32 levelToGenerate, GameObject *player) {
 	// Clear the previous level data from the world state
-	// Note: We start at index 1 because the player is at index 0 and we want to keep them!
-	for (u32 i = 1; i < MAX_GO; i++) {
-		if ((gameObjects[i].id != player->id) && 
-			(gameObjects[i].id != UNUSED) &&
-			list_search(carriedItems, &gameObjects[i]) == NULL) {
+	// Note: We keep the player, and anything they're carrying!
+	for (u32 i = 0; i < entityTable.slotsUsed; i++) {
+		GameObject *go = entity_slot(i);
+		if ((go != player) && 
+			(go->id != ENTITY_NONE) &&
+			list_search(carriedItems, go) == NULL) {
 
-			game_object_destroy(&gameObjects[i]);
+			game_object_destroy(go);
 		}
 	}
 
@@ -864,18 +909,14 @@ DungeonLevel * level_init(i32 levelToGenerate, GameObject *player) {
 
 	for (u32 x = 0; x < MAP_WIDTH; x++) {
 		for (u32 y = 0; y < MAP_HEIGHT; y++) {
-			if (mapCells[x][y]) {
-				wall_add(x, y);
-			} else {
-				floor_add(x, y);
-			}
+			terrain_set(x, y, mapCells[x][y] ? TERRAIN_WALL : TERRAIN_FLOOR);
 		}
 	}
+	free(mapCells);
 
 	// Create DungeonLevel Object and store relevant info
 	DungeonLevel *level = calloc(1, sizeof(DungeonLevel));
 	level->level = levelToGenerate;
-	level->mapWalls = mapCells;
 
 	// Grab the number of monsters to generate for this level from level config
 	i32 monstersToAdd = maxMonsters[levelToGenerate-1];
@@ -886,7 +927,7 @@ DungeonLevel * level_init(i32 levelToGenerate, GameObject *player) {
 
 		if (monsterEntity != NULL) {
 			// Add the monster		
-			Point pt = level_get_open_point(mapCells);
+			Point pt = level_get_open_point();
 			char *name = config_entity_value(monsterEntity, "name");
 			char *glyph = config_entity_value(monsterEntity, "vis_glyph");
 			asciiChar g = atoi(glyph);
@@ -917,7 +958,7 @@ DungeonLevel * level_init(i32 levelToGenerate, GameObject *player) {
 
 		if (entity != NULL) {
 			// Add the item		
-			Point pt = level_get_open_point(mapCells);
+			Point pt = level_get_open_point();
 			char *name = config_entity_value(entity, "name");
 			char *glyph = config_entity_value(entity, "vis_glyph");
 			asciiChar g = atoi(glyph);
@@ -940,7 +981,7 @@ DungeonLevel * level_init(i32 levelToGenerate, GameObject *player) {
 	gemsFoundThisLevel = 0;
 	for (i32 i = 0; i < GEMS_PER_LEVEL; i++) {
 		GameObject *gem = game_object_create();
-		Point ptGem = level_get_open_point(mapCells);
+		Point ptGem = level_get_open_point();
 		Position gemPos = {.objectId = gem->id, .x = ptGem.x, .y = ptGem.y, .layer = LAYER_MID};
 		game_object_update_component(gem, COMP_POSITION, &gemPos);
 		Visibility vis = {.objectId = gem->id, .glyph = 4, .fgColor = 0x753aabff, .bgColor = 0x00000000, .visibleOutsideFOV = false, .name="Gem"};
@@ -955,7 +996,7 @@ DungeonLevel * level_init(i32 levelToGenerate, GameObject *player) {
 
 	// Place a staircase in a random position in the level
 	GameObject *stairs = game_object_create();
-	Point ptStairs = level_get_open_point(mapCells);
+	Point ptStairs = level_get_open_point();
 	Position stairPos = {.objectId = stairs->id, .x = ptStairs.x, .y = ptStairs.y, .layer = LAYER_MID};
 	game_object_update_component(stairs, COMP_POSITION, &stairPos);
 	if (levelToGenerate < 20) {
@@ -969,7 +1010,7 @@ DungeonLevel * level_init(i32 levelToGenerate, GameObject *player) {
 	game_object_update_component(stairs, COMP_PHYSICAL, &phys);
 
 	// Place our player in a random position in the level
-	Point pt = level_get_open_point(mapCells);
+	Point pt = level_get_open_point();
 	Position pos = {.objectId = player->id, .x = pt.x, .y = pt.y, .layer = LAYER_TOP};
 	game_object_update_component(player, COMP_POSITION, &pos);
 
@@ -981,17 +1022,15 @@ void level_descend() {
 	Position *playerPos = (Position *)game_object_get_component(player, COMP_POSITION);
 
 	// Get objects at player's current position
-	List *objects = game_objects_at_position(playerPos->x, playerPos->y);
-	ListElement *e = list_head(objects);
+	GameObject *go = game_objects_at_position(playerPos->x, playerPos->y);
 	bool foundStairs = false;
-	while (e != NULL) {
-		GameObject *go = (GameObject *)list_data(e);
+	while (go != NULL) {
 		Visibility *v = (Visibility *)game_object_get_component(go, COMP_VISIBILITY);
 		if ((v != NULL) && (String_Equals(v->name, "Stairs"))) {
 			foundStairs = true;
 			break;
 		}
-		e = list_next(e);
+		go = game_object_next_at_position(go);
 	}
 
 	if (foundStairs) {
@@ -1013,6 +1052,7 @@ void level_descend() {
 		Combat *combatStats = (Combat *)game_object_get_component(player, COMP_COMBAT);
 		combatStats->attack += 2;
 		combatStats->defense += 1;
+		in_game_mark_stats_dirty();
 
 	} else {
 		add_message("There are no stairs here, you silly person.", 0x555555ff);
@@ -1046,32 +1086,20 @@ void add_message(char *msg, u32 color) {
 		list_remove(messageLog, NULL);  // Remove the oldest message
 	}
 
+	in_game_mark_log_dirty();
+
 }
 
 /* Movement System */
 
 bool can_move(Position pos) {
-	bool moveAllowed = true;
-
-	if ((pos.x >= 0) && (pos.x < NUM_COLS) && (pos.y >= 0) && (pos.y < NUM_ROWS)) {
-		ListElement *e = list_head(positionComps);
-		while (e != NULL) {
-			Position *p = (Position *)list_data(e);
-			if (p->x == pos.x && p->y == pos.y) {
-				Physical *phys = (Physical *)game_object_get_component(&gameObjects[p->objectId], COMP_PHYSICAL);
-				if (phys->blocksMovement == true) {
-					moveAllowed = false;
-					break;
-				}
-			}		
-			e = list_next(e);
-		}
-
-	} else {
-		moveAllowed = false;
+	// Anything off the map is out of bounds, and anything on it is open 
+	// unless its terrain, or something there, blocks movement
+	if ((pos.x >= MAP_WIDTH) || (pos.y >= MAP_HEIGHT)) {
+		return false;
 	}
-
-	return moveAllowed;
+	return !terrain_blocks(pos.x, pos.y, TILE_BLOCKS_MOVEMENT) && 
+		   (movementBlockers[pos.x][pos.y] == 0);
 }
 
 
@@ -1081,7 +1109,7 @@ typedef struct {
 } TargetPoint;
 
 bool is_wall(i32 x, i32 y) {
-	return currentLevel->mapWalls[x][y];
+	return terrain_blocks(x, y, TILE_BLOCKS_MOVEMENT);
 }
 
 // TODO: Allow for a list of target points to be provided, with differing starting weights/priorities?
@@ -1139,15 +1167,17 @@ void generate_target_map(i32 targetX, i32 targetY) { // List *targetPoints) {
 
 void movement_update() {
 
-	ListElement *e = list_head(movementComps);
-	while (e != NULL) {
-		Movement *mv = (Movement *)list_data(e);
+	// Newest first. Nothing gains or loses a Movement while things move.
+	Movement *movements = (Movement *)component_array(COMP_MOVEMENT);
+	for (i32 i = (i32)component_count(COMP_MOVEMENT) - 1; i >= 0; i--) {
+		Movement *mv = &movements[i];
+		GameObject *mover = game_object_get(mv->objectId);
 
 		// Determine if the object is going to move this tick
 		mv->ticksUntilNextMove -= 1;
 		if (mv->ticksUntilNextMove <= 0) {
 			// The object is moving, so determine new position based on destination and speed
-			Position *p = (Position *)game_object_get_component(&gameObjects[mv->objectId], COMP_POSITION);
+			Position *p = (Position *)game_object_get_component(mover, COMP_POSITION);
 			Position newPos = {.objectId = p->objectId, .x = p->x, .y = p->y, .layer = p->layer};
 
 			// A monster should only move toward the player if they have seen the player
@@ -1174,7 +1204,7 @@ void movement_update() {
 				// Determine if we're currently in combat range of the player
 				if ((fovMap[p->x][p->y] > 0) && (targetMap[p->x][p->y] == 1)) {
 					// Combat range - so attack the player
-					combat_attack(&gameObjects[mv->objectId], player);
+					combat_attack(mover, player);
 
 				} else {
 					// Out of combat range, so determine new position based on our target map
@@ -1233,7 +1263,7 @@ void movement_update() {
 
 					// Test to see if the new position can be moved to
 					if (can_move(newPos)) {
-						game_object_update_component(&gameObjects[mv->objectId], COMP_POSITION, &newPos);
+						game_object_update_component(mover, COMP_POSITION, &newPos);
 						mv->ticksUntilNextMove = mv->frequency;				
 					} else {
 						mv->ticksUntilNextMove += 1;
@@ -1243,8 +1273,6 @@ void movement_update() {
 				speedCounter -= 1;
 			}
 		}
-
-		e = list_next(e);
 	}
 
 
@@ -1277,10 +1305,11 @@ void health_check_death(GameObject *go) {
 
 			Position *pos = (Position *)game_object_get_component(go, COMP_POSITION);
 			pos->layer = LAYER_GROUND;
+			render_index_update_cell(pos->x, pos->y);
 
-			Physical *phys = (Physical *)game_object_get_component(go, COMP_PHYSICAL);
-			phys->blocksMovement = false;
-			phys->blocksSight = false;
+			// The corpse no longer gets in the way
+			Physical phys = {.objectId = go->id, .blocksMovement = false, .blocksSight = false};
+			game_object_update_component(go, COMP_PHYSICAL, &phys);
 
 			// Remove the movement component - no more moving!
 			game_object_update_component(go, COMP_MOVEMENT, NULL);
@@ -1302,39 +1331,32 @@ void health_recover_player_only() {
 
 void health_recover() {
 	// Loop through all our health components and apply recovery HP (only if object is not already dead)
-	ListElement *e = list_head(healthComps);
-	while (e != NULL) {
-		Health *h = (Health *)list_data(e);
+	Health *healths = (Health *)component_array(COMP_HEALTH);
+	for (u32 i = 0; i < component_count(COMP_HEALTH); i++) {
+		Health *h = &healths[i];
 		if (h->currentHP > 0) {
 			h->currentHP += h->recoveryRate;
 			if (h->currentHP > h->maxHP) { 
 				h->currentHP = h->maxHP;
 			}			
 		}
-		e = list_next(e);
 	}
 }
 
 void health_removal_update() {
 	// Loop through all our health components and remove any objects that have been dead for awhile. 
-	// Decrement counters for newly-dead objects
-	ListElement *e = list_head(healthComps);
-	while (e != NULL) {
-		Health *h = (Health *)list_data(e);
+	// Decrement counters for newly-dead objects. Going from the back, the component 
+	// moved into the place of one that's destroyed has already been looked at.
+	Health *healths = (Health *)component_array(COMP_HEALTH);
+	for (i32 i = (i32)component_count(COMP_HEALTH) - 1; i >= 0; i--) {
+		Health *h = &healths[i];
 		if (h->currentHP <= 0) {
 			if (h->ticksUntilRemoval <= 0) {
 				// Remove object and all related components from world state
-				GameObject goToDestroy = gameObjects[h->objectId];
-				e = list_next(e);	// Grab the next element in the list, because we're about to destroy this one
-				game_object_destroy(&goToDestroy);
-
+				game_object_destroy(game_object_get(h->objectId));
 			} else {
 				h->ticksUntilRemoval -= 1;
-	 			e = list_next(e);
 			}
-
-		} else {
-			e = list_next(e);
 		}
 	}
 }
@@ -1428,13 +1450,11 @@ i32 item_get_weight_carried() {
 void item_get() {
 	Position *playerPos = (Position *)game_object_get_component(player, COMP_POSITION);
 	// Get the item at player's current position
-	List *objects = game_objects_at_position(playerPos->x, playerPos->y);
 	GameObject *itemObj = NULL;
 	Equipment *eq = NULL;
 	Treasure *t = NULL;
-	ListElement *e = list_head(objects);
-	while (e != NULL) {
-		GameObject *go = (GameObject *)list_data(e);
+	GameObject *go = game_objects_at_position(playerPos->x, playerPos->y);
+	while (go != NULL) {
 		eq = (Equipment *)game_object_get_component(go, COMP_EQUIPMENT);
 		if (eq != NULL) {
 			itemObj = go;
@@ -1445,12 +1465,13 @@ void item_get() {
 			itemObj = go;
 			break;
 		}
-		e = list_next(e);
+		go = game_object_next_at_position(go);
 	}
 
 	if (itemObj != NULL && t != NULL) {
 		gemsFoundThisLevel += 1;
 		gemsFoundTotal += 1;
+		in_game_mark_stats_dirty();
 
 		Visibility *v = (Visibility *)game_object_get_component(itemObj, COMP_VISIBILITY);
 		if (v != NULL) {
@@ -1535,6 +1556,7 @@ void item_toggle_equip(GameObject *item) {
 
 	Equipment *eq = (Equipment *)game_object_get_component(item, COMP_EQUIPMENT);
 	if (eq != NULL) {
+		in_game_mark_stats_dirty();
 		eq->isEquipped = !eq->isEquipped;
 		Combat *playerCombat = (Combat *)game_object_get_component(player, COMP_COMBAT);
 		Combat *c = (Combat *)game_object_get_component(item, COMP_COMBAT);
@@ -1577,16 +1599,15 @@ void item_drop(GameObject *item) {
 	Position *playerPos = (Position *)game_object_get_component(player, COMP_POSITION);
 
 	// Check to see if the the item can be dropped
-	List *objects = game_objects_at_position(playerPos->x, playerPos->y);
 	bool canBeDropped = true;
-	ListElement *le = list_head(objects);
-	while (le != NULL) {
-		Equipment *eq = (Equipment *)game_object_get_component(le->data, COMP_EQUIPMENT);
+	GameObject *go = game_objects_at_position(playerPos->x, playerPos->y);
+	while (go != NULL) {
+		Equipment *eq = (Equipment *)game_object_get_component(go, COMP_EQUIPMENT);
 		if (eq != NULL) {
 			canBeDropped = false;
 			break;
 		}
-		le = list_next(le);
+		go = game_object_next_at_position(go);
 	}
 
 	if (canBeDropped) {
@@ -1622,11 +1643,9 @@ void item_drop(GameObject *item) {
 
 void environment_update(Position *playerPos) {
 	// Check to see if there are any items at player's current position
-	List *objects = game_objects_at_position(playerPos->x, playerPos->y);
 	GameObject *itemObj = NULL;
-	ListElement *e = list_head(objects);
-	while (e != NULL) {
-		GameObject *go = (GameObject *)list_data(e);
+	GameObject *go = game_objects_at_position(playerPos->x, playerPos->y);
+	while (go != NULL) {
 		Equipment *eqComp = (Equipment *)game_object_get_component(go, COMP_EQUIPMENT);
 		if (eqComp != NULL) {
 			itemObj = go;
@@ -1646,7 +1665,7 @@ void environment_update(Position *playerPos) {
 			add_message(msg, 0xffd700ff);
 			String_Destroy(msg);
 		}
-		e = list_next(e);
+		go = game_object_next_at_position(go);
 	}
 	if (itemObj != NULL) {
 		Visibility *v = (Visibility *)game_object_get_component(itemObj, COMP_VISIBILITY);
@@ -1661,29 +1680,44 @@ void environment_update(Position *playerPos) {
 
 /* Animation Management Routines */
 
-void animation_update() {
+u32 animation_update(u32 elapsedTicks) {
 	// Look at all animations in the list and do any necessary clean up or
-	// keyframe work.
-	ListElement *e = list_head(animationComps);
-	while (e != NULL) {
-		Animation *anim = (Animation *)list_data(e);
+	// keyframe work. Returns the number of keyframes that were run.
+	u32 keyframeCount = 0;
+	Animation *animations = (Animation *)component_array(COMP_ANIMATION);
+	for (i32 i = (i32)component_count(COMP_ANIMATION) - 1; i >= 0; i--) {
+		Animation *anim = &animations[i];
 		if (anim->finished) {
 			// Animation is done - clean it up
-			ListElement *eToRemove = e;
-			e = list_prev(e);
-			GameObject go = gameObjects[anim->objectId];
-			game_object_update_component(&go, COMP_ANIMATION, NULL);
+			game_object_update_component(game_object_get(anim->objectId), COMP_ANIMATION, NULL);
+			continue;
 		}
 
-		anim->ticksUntilKeyframe -= 1;
+		anim->ticksUntilKeyframe -= (i32)elapsedTicks;
 		if (anim->ticksUntilKeyframe <= 0) {
-			// Time for a keyframe
+			// Time for a keyframe. If we've fallen behind, only one is run and 
+			// the missed ones are dropped, rather than replaying them all at once.
 			anim->ticksUntilKeyframe = anim->keyFrameInterval;
 			anim->keyframeAnimation(anim->objectId);
+			keyframeCount += 1;
 		}
-
-		e = list_next(e);
 	}	
+
+	return keyframeCount;
+}
+
+i32 animation_ticks_until_keyframe() {
+	// How long until the next keyframe is due, or -1 if nothing is animating
+	i32 ticks = -1;
+	Animation *animations = (Animation *)component_array(COMP_ANIMATION);
+	for (u32 i = 0; i < component_count(COMP_ANIMATION); i++) {
+		Animation *anim = &animations[i];
+		if ((ticks < 0) || (anim->ticksUntilKeyframe < ticks)) {
+			ticks = anim->ticksUntilKeyframe;
+		}
+	}
+
+	return (ticks < 0) ? -1 : ticks;
 }
 
 
@@ -1723,9 +1757,16 @@ game_update()
 {
 	// Have things move themselves around the dungeon if the player moved
 	if (playerTookTurn) {
+		// Combat and recovery can change the player's stats on any turn
+		in_game_mark_stats_dirty();
+
 		Position *playerPos = (Position *)game_object_get_component(player, COMP_POSITION);
+		PERF_BEGIN(PERF_TARGET_MAP);
 		generate_target_map(playerPos->x, playerPos->y);
+		PERF_END(PERF_TARGET_MAP);
+		PERF_BEGIN(PERF_MOVEMENT);
 		movement_update();		
+		PERF_END(PERF_MOVEMENT);
 		item_lifetime_update();
 		environment_update(playerPos);
 
@@ -1735,12 +1776,11 @@ game_update()
 	// Recalculate the FOV if warranted
 	if (recalculateFOV) {
 		Position *pos = (Position *)game_object_get_component(player, COMP_POSITION);
+		PERF_BEGIN(PERF_FOV);
 		fov_calculate(pos->x, pos->y, fovMap);
+		PERF_END(PERF_FOV);
 		recalculateFOV = false;
 	}
-
-	// Check for animation updates
-	animation_update();
 }
 
 internal void
@@ -1827,7 +1867,7 @@ game_over() {
 
 // Animations
 
-void animateGem(u32 gameObjectId) {
+void animateGem(EntityHandle gameObjectId) {
 	// Gem color will cycle up to "maximum white" and then 
 	// back to original purple, giving a shine effect.
 	// Gem original color = 0x753aabff
@@ -1836,14 +1876,15 @@ void animateGem(u32 gameObjectId) {
 	u32 oBlue = 0xab;
 	u32 oAlpha = 0xff;
 
-	// Get our game object
-	GameObject go = gameObjects[gameObjectId];
+	// Get our game object, if it's still around
+	GameObject *go = game_object_get(gameObjectId);
+	if (go == NULL) { return; }
 
 	// Get the animation component
-	Animation *anim = (Animation *)game_object_get_component(&go, COMP_ANIMATION);
+	Animation *anim = (Animation *)game_object_get_component(go, COMP_ANIMATION);
 
 	// Get the visual component
-	Visibility *vis = (Visibility *)game_object_get_component(&go, COMP_VISIBILITY);
+	Visibility *vis = (Visibility *)game_object_get_component(go, COMP_VISIBILITY);
 	
 	u32 color = vis->fgColor;
 	u32 r = RED(color);
@@ -0,0 +1,323 @@
+/*
+* pack.c - Prebuilt asset pack
+*
+* A single file holding assets that are otherwise decoded and processed from
+* PNGs at runtime, already in the form the game uses them. The pack is mapped
+* into memory and its data used in place. Every entry records the size and
+* modification time of the files it was built from, so entries whose sources
+* have changed since are ignored and the game falls back to the PNGs.
+*/
+
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define ASSET_PACK_MAGIC		0x4b504344		// "DCPK" when read back on the same machine
+#define ASSET_PACK_VERSION		2				// bump when the layout or asset processing changes
+#define ASSET_PACK_ALIGN		64
+#define ASSET_PACK_MAX_ENTRIES	64
+#define ASSET_PATH_MAX			64
+
+typedef enum {
+	ASSET_FONT_ATLAS = 1,	// atlas pixels, byte-swapped and with black keyed out
+	ASSET_BITMAP,			// image pixels, byte-swapped
+	ASSET_ASCII_IMAGE,		// asciified image cells, for one font and cell size
+	ASSET_FONT_COVERAGE,	// atlas alpha, one byte per pixel, for colorized fonts
+} AssetKind;
+
+// A file an entry was built from
+typedef struct {
+	char path[ASSET_PATH_MAX];
+	u64 size;
+	i64 modifiedTime;
+} AssetSource;
+
+typedef struct {
+	u32 kind;
+	u32 cellWidth;			// font atlases and ascii images: char / cell size
+	u32 cellHeight;
+	u32 width;				// pixels for atlases and bitmaps, cols for ascii images
+	u32 height;				// pixels for atlases and bitmaps, rows for ascii images
+	u32 sourceCount;
+	AssetSource sources[2];	// the asset itself, then the font for ascii images
+	u64 dataOffset;			// from the start of the pack
+	u64 dataSize;
+} AssetPackEntry;
+
+typedef struct {
+	u32 magic;
+	u32 version;
+	u32 entryCount;
+	u32 reserved;
+	u64 fileSize;
+} AssetPackHeader;
+
+typedef struct {
+	u8 *data;
+	u64 size;
+	bool mapped;			// false if the file was read into memory instead
+	AssetPackHeader *header;
+	AssetPackEntry *entries;
+} AssetPack;
+
+global_variable AssetPack assetPack = {0};
+
+typedef struct {
+	AssetPackEntry entries[ASSET_PACK_MAX_ENTRIES];
+	void *entryData[ASSET_PACK_MAX_ENTRIES];
+	u32 entryCount;
+} AssetPackWriter;
+
+
+internal bool
+asset_source_stat(char *path, AssetSource *source)
+{
+	struct stat fileInfo;
+	if (stat(path, &fileInfo) != 0) {
+		return false;
+	}
+
+	memset(source, 0, sizeof(AssetSource));
+	strncpy(source->path, path, ASSET_PATH_MAX - 1);
+	source->size = (u64)fileInfo.st_size;
+	source->modifiedTime = (i64)fileInfo.st_mtime;
+	return true;
+}
+
+internal bool
+asset_source_is_current(AssetSource *source)
+{
+	AssetSource current;
+	if (!asset_source_stat(source->path, &current)) {
+		return false;
+	}
+	return (current.size == source->size) && (current.modifiedTime == source->modifiedTime);
+}
+
+internal void
+asset_pack_close()
+{
+	if (assetPack.data == NULL) { return; }
+
+#ifndef _WIN32
+	if (assetPack.mapped) {
+		munmap(assetPack.data, assetPack.size);
+	} else {
+		free(assetPack.data);
+	}
+#else
+	free(assetPack.data);
+#endif
+
+	memset(&assetPack, 0, sizeof(AssetPack));
+}
+
+/*
+Maps the pack at filename into memory. Returns false, leaving the game to
+load everything from PNGs, if the pack is missing or from another version.
+*/
+internal bool
+asset_pack_open(char *filename)
+{
+	u8 *data = NULL;
+	u64 size = 0;
+	bool mapped = false;
+
+#ifndef _WIN32
+	i32 fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat fileInfo;
+	if ((fstat(fd, &fileInfo) == 0) && (fileInfo.st_size >= (off_t)sizeof(AssetPackHeader))) {
+		size = (u64)fileInfo.st_size;
+		void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping != MAP_FAILED) {
+			data = (u8 *)mapping;
+			mapped = true;
+		}
+	}
+	close(fd);
+#else
+	// No mmap here, so read the whole pack in instead
+	FILE *fp = fopen(filename, "rb");
+	if (fp == NULL) {
+		return false;
+	}
+	fseek(fp, 0, SEEK_END);
+	long fileSize = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (fileSize >= (long)sizeof(AssetPackHeader)) {
+		size = (u64)fileSize;
+		data = malloc(size);
+		if (fread(data, 1, size, fp) != size) {
+			free(data);
+			data = NULL;
+		}
+	}
+	fclose(fp);
+#endif
+
+	if (data == NULL) {
+		return false;
+	}
+
+	assetPack.data = data;
+	assetPack.size = size;
+	assetPack.mapped = mapped;
+	assetPack.header = (AssetPackHeader *)data;
+	assetPack.entries = (AssetPackEntry *)(data + sizeof(AssetPackHeader));
+
+	AssetPackHeader *header = assetPack.header;
+	bool valid = (header->magic == ASSET_PACK_MAGIC) &&
+				 (header->version == ASSET_PACK_VERSION) &&
+				 (header->fileSize == size) &&
+				 (header->entryCount <= ASSET_PACK_MAX_ENTRIES) &&
+				 (sizeof(AssetPackHeader) + (header->entryCount * sizeof(AssetPackEntry)) <= size);
+	for (u32 i = 0; valid && (i < header->entryCount); i++) {
+		AssetPackEntry *entry = &assetPack.entries[i];
+		valid = (entry->dataOffset <= size) && (entry->dataSize <= size - entry->dataOffset);
+	}
+
+	if (!valid) {
+		printf("Ignoring asset pack %s - it is out of date or damaged\n", filename);
+		asset_pack_close();
+		return false;
+	}
+
+	return true;
+}
+
+/*
+Looks up an asset built from source (and fontSource, for ascii images) with
+the given cell size. Returns NULL if there is no such entry, or if any file
+it was built from has changed since.
+*/
+internal AssetPackEntry *
+asset_pack_find(AssetKind kind, char *source, char *fontSource, u32 cellWidth, u32 cellHeight)
+{
+	if (assetPack.data == NULL) { return NULL; }
+
+	for (u32 i = 0; i < assetPack.header->entryCount; i++) {
+		AssetPackEntry *entry = &assetPack.entries[i];
+		if ((entry->kind != kind) ||
+			(entry->cellWidth != cellWidth) || (entry->cellHeight != cellHeight) ||
+			(strncmp(entry->sources[0].path, source, ASSET_PATH_MAX) != 0)) {
+			continue;
+		}
+		if ((fontSource != NULL) &&
+			((entry->sourceCount < 2) ||
+			 (strncmp(entry->sources[1].path, fontSource, ASSET_PATH_MAX) != 0))) {
+			continue;
+		}
+
+		for (u32 s = 0; s < entry->sourceCount; s++) {
+			if (!asset_source_is_current(&entry->sources[s])) {
+				return NULL;
+			}
+		}
+		return entry;
+	}
+
+	return NULL;
+}
+
+internal void *
+asset_pack_entry_data(AssetPackEntry *entry)
+{
+	return assetPack.data + entry->dataOffset;
+}
+
+
+/* Asset Pack Building */
+
+internal AssetPackWriter *
+asset_pack_writer_new()
+{
+	return calloc(1, sizeof(AssetPackWriter));
+}
+
+/*
+Adds an asset to the pack being built. The data is copied when the pack is
+saved, so it must stay around until then.
+*/
+internal bool
+asset_pack_writer_add(AssetPackWriter *writer, AssetKind kind,
+					  char *source, char *fontSource, u32 cellWidth, u32 cellHeight,
+					  u32 width, u32 height, void *data, u64 dataSize)
+{
+	assert(writer->entryCount < ASSET_PACK_MAX_ENTRIES);
+	assert(strlen(source) < ASSET_PATH_MAX);
+
+	AssetPackEntry *entry = &writer->entries[writer->entryCount];
+	memset(entry, 0, sizeof(AssetPackEntry));
+	entry->kind = kind;
+	entry->cellWidth = cellWidth;
+	entry->cellHeight = cellHeight;
+	entry->width = width;
+	entry->height = height;
+	entry->dataSize = dataSize;
+
+	if (!asset_source_stat(source, &entry->sources[0])) {
+		return false;
+	}
+	entry->sourceCount = 1;
+	if (fontSource != NULL) {
+		assert(strlen(fontSource) < ASSET_PATH_MAX);
+		if (!asset_source_stat(fontSource, &entry->sources[1])) {
+			return false;
+		}
+		entry->sourceCount = 2;
+	}
+
+	writer->entryData[writer->entryCount] = data;
+	writer->entryCount += 1;
+	return true;
+}
+
+internal bool
+asset_pack_writer_save(AssetPackWriter *writer, char *filename)
+{
+	// Lay out the data, with each entry's data aligned after the entry table
+	u64 offset = sizeof(AssetPackHeader) + (writer->entryCount * sizeof(AssetPackEntry));
+	for (u32 i = 0; i < writer->entryCount; i++) {
+		offset = (offset + ASSET_PACK_ALIGN - 1) & ~((u64)ASSET_PACK_ALIGN - 1);
+		writer->entries[i].dataOffset = offset;
+		offset += writer->entries[i].dataSize;
+	}
+
+	AssetPackHeader header = {0};
+	header.magic = ASSET_PACK_MAGIC;
+	header.version = ASSET_PACK_VERSION;
+	header.entryCount = writer->entryCount;
+	header.fileSize = offset;
+
+	FILE *fp = fopen(filename, "wb");
+	if (fp == NULL) {
+		return false;
+	}
+
+	bool ok = (fwrite(&header, sizeof(header), 1, fp) == 1);
+	if (writer->entryCount > 0) {
+		ok = ok && (fwrite(writer->entries, sizeof(AssetPackEntry), writer->entryCount, fp) == writer->entryCount);
+	}
+	for (u32 i = 0; ok && (i < writer->entryCount); i++) {
+		AssetPackEntry *entry = &writer->entries[i];
+		while (ok && ((u64)ftell(fp) < entry->dataOffset)) {
+			ok = (fputc(0, fp) != EOF);
+		}
+		ok = ok && (fwrite(writer->entryData[i], 1, entry->dataSize, fp) == entry->dataSize);
+	}
+
+	fclose(fp);
+	return ok;
+}
+
+internal void
+asset_pack_writer_destroy(AssetPackWriter *writer)
+{
+	free(writer);
+}
@@ -0,0 +1,142 @@
+/*
+* perf.c - Frame timings for the performance overlay
+*
+* Build with -DPERF_OVERLAY=1 to time every rendered frame, broken down by
+* view and by game system, and to toggle an overlay showing it all with F3.
+* Otherwise the timing hooks below compile to nothing.
+*/
+
+#ifndef PERF_OVERLAY
+#define PERF_OVERLAY	0
+#endif
+
+#if PERF_OVERLAY
+
+#define PERF_FRAME_HISTORY	128		// frames the percentiles are taken over
+#define PERF_VIEWS_MAX		16
+
+typedef enum {
+	PERF_GAME_UPDATE,
+	PERF_TARGET_MAP,
+	PERF_MOVEMENT,
+	PERF_FOV,
+	PERF_ANIMATION,
+	PERF_RENDER,		// all view render functions
+	PERF_BLEND,			// rasterizing consoles into the framebuffer
+	PERF_UPLOAD,		// framebuffer to texture
+	PERF_PRESENT,
+	PERF_TIMER_COUNT
+} PerfTimer;
+
+global_variable char *perfTimerNames[PERF_TIMER_COUNT] = {
+	"game update",
+	" target map",
+	" movement",
+	" fov",
+	" animation",
+	"render",
+	"blend",
+	"upload",
+	"present",
+};
+
+typedef struct {
+	u64 frameStart;
+	u64 timers[PERF_TIMER_COUNT];		// the frame in progress
+	u64 viewTimers[PERF_VIEWS_MAX];
+
+	u64 lastTimers[PERF_TIMER_COUNT];	// the last frame that was presented
+	u64 lastViewTimers[PERF_VIEWS_MAX];
+
+	u64 frameTimes[PERF_FRAME_HISTORY];
+	u32 frameCount;
+} PerfStats;
+
+global_variable PerfStats perfStats = {0};
+
+internal void
+perf_frame_begin()
+{
+	perfStats.frameStart = SDL_GetPerformanceCounter();
+	memset(perfStats.timers, 0, sizeof(perfStats.timers));
+	memset(perfStats.viewTimers, 0, sizeof(perfStats.viewTimers));
+}
+
+internal void
+perf_frame_end()
+{
+	u64 frameTime = SDL_GetPerformanceCounter() - perfStats.frameStart;
+	perfStats.frameTimes[perfStats.frameCount % PERF_FRAME_HISTORY] = frameTime;
+	perfStats.frameCount += 1;
+
+	memcpy(perfStats.lastTimers, perfStats.timers, sizeof(perfStats.timers));
+	memcpy(perfStats.lastViewTimers, perfStats.viewTimers, sizeof(perfStats.viewTimers));
+}
+
+internal void
+perf_add(PerfTimer timer, u64 ticks)
+{
+	perfStats.timers[timer] += ticks;
+}
+
+internal void
+perf_add_view(u32 viewIndex, u64 ticks)
+{
+	if (viewIndex < PERF_VIEWS_MAX) {
+		perfStats.viewTimers[viewIndex] += ticks;
+	}
+}
+
+internal double
+perf_ticks_to_ms(u64 ticks)
+{
+	return (ticks * 1000.0) / SDL_GetPerformanceFrequency();
+}
+
+internal int
+perf_compare_ticks(const void *a, const void *b)
+{
+	u64 ta = *(const u64 *)a;
+	u64 tb = *(const u64 *)b;
+	return (ta > tb) - (ta < tb);
+}
+
+/*
+Fills in the 50th, 95th and 99th percentile frame times, in ms, over the
+last PERF_FRAME_HISTORY frames.
+*/
+internal void
+perf_frame_percentiles(double *p50, double *p95, double *p99)
+{
+	u32 count = (perfStats.frameCount < PERF_FRAME_HISTORY) ? perfStats.frameCount : PERF_FRAME_HISTORY;
+	if (count == 0) {
+		*p50 = *p95 = *p99 = 0.0;
+		return;
+	}
+
+	u64 sorted[PERF_FRAME_HISTORY];
+	memcpy(sorted, perfStats.frameTimes, count * sizeof(u64));
+	qsort(sorted, count, sizeof(u64), perf_compare_ticks);
+
+	*p50 = perf_ticks_to_ms(sorted[(count * 50) / 100]);
+	*p95 = perf_ticks_to_ms(sorted[(count * 95) / 100]);
+	*p99 = perf_ticks_to_ms(sorted[(count * 99) / 100]);
+}
+
+#define PERF_FRAME_BEGIN()			perf_frame_begin()
+#define PERF_FRAME_END()			perf_frame_end()
+#define PERF_BEGIN(timer)			u64 perfStart_##timer = SDL_GetPerformanceCounter()
+#define PERF_END(timer)				perf_add(timer, SDL_GetPerformanceCounter() - perfStart_##timer)
+#define PERF_VIEW_BEGIN()			u64 perfViewStart = SDL_GetPerformanceCounter()
+#define PERF_VIEW_END(viewIndex)	perf_add_view(viewIndex, SDL_GetPerformanceCounter() - perfViewStart)
+
+#else
+
+#define PERF_FRAME_BEGIN()
+#define PERF_FRAME_END()
+#define PERF_BEGIN(timer)
+#define PERF_END(timer)
+#define PERF_VIEW_BEGIN()
+#define PERF_VIEW_END(viewIndex)
+
+#endif
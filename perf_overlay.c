@@ -0,0 +1,115 @@
+/*
+* perf_overlay.c - Overlay view showing the frame timings from perf.c
+*/
+
+#if PERF_OVERLAY
+
+#define PERF_OVERLAY_WIDTH		30
+#define PERF_OVERLAY_HEIGHT		40
+
+global_variable UIView *perfOverlayView = NULL;
+global_variable UIScreen *perfOverlayScreen = NULL;		// the screen it's on, if showing
+global_variable bool perfOverlayShowing = false;
+
+
+internal void
+perf_overlay_put_line(Console *console, i32 *y, u32 color, char *text)
+{
+	if (*y < PERF_OVERLAY_HEIGHT) {
+		console_put_string_at(console, text, 1, *y, color, 0x00000000);
+	}
+	*y += 1;
+}
+
+internal void
+render_perf_overlay_view(Console *console)
+{
+	UIRect rect = {0, 0, PERF_OVERLAY_WIDTH, PERF_OVERLAY_HEIGHT};
+	view_draw_rect(console, &rect, 0x000000cc, 0, 0);
+
+	i32 y = 1;
+
+	// Frame times, over the last PERF_FRAME_HISTORY frames
+	double p50, p95, p99;
+	perf_frame_percentiles(&p50, &p95, &p99);
+	perf_overlay_put_line(console, &y, 0xffffffff, frame_string("Frames: %u", perfStats.frameCount));
+	perf_overlay_put_line(console, &y, 0xe6e600ff, frame_string(" p50 %7.2f ms", p50));
+	perf_overlay_put_line(console, &y, 0xe6e600ff, frame_string(" p95 %7.2f ms", p95));
+	perf_overlay_put_line(console, &y, 0xe6e600ff, frame_string(" p99 %7.2f ms", p99));
+	y += 1;
+
+	// Where the last frame went
+	perf_overlay_put_line(console, &y, 0xffffffff, "Last frame:");
+	for (u32 t = 0; t < PERF_TIMER_COUNT; t++) {
+		char *line = frame_string(" %-13s %7.3f ms", perfTimerNames[t],
+								  perf_ticks_to_ms(perfStats.lastTimers[t]));
+		perf_overlay_put_line(console, &y, 0xaaaaaaff, line);
+	}
+	y += 1;
+
+	// Render time of each view on this screen, from the back
+	perf_overlay_put_line(console, &y, 0xffffffff, "Views:");
+	u32 viewIndex = 0;
+	for (ListElement *e = list_head(perfOverlayScreen->views); e != NULL; e = list_next(e)) {
+		UIView *view = (UIView *)list_data(e);
+		if ((view != perfOverlayView) && !view->hidden && (viewIndex < PERF_VIEWS_MAX)) {
+			char *line = frame_string(" %2u %3ux%-3u %11.3f ms", viewIndex,
+									  view->console->colCount, view->console->rowCount,
+									  perf_ticks_to_ms(perfStats.lastViewTimers[viewIndex]));
+			perf_overlay_put_line(console, &y, 0xaaaaaaff, line);
+		}
+		viewIndex += 1;
+	}
+	y += 1;
+
+	// What there is for the game systems to chew through
+	if (currentlyInGame) {
+		perf_overlay_put_line(console, &y, 0xffffffff, "Entities:");
+		perf_overlay_put_line(console, &y, 0xaaaaaaff, frame_string(" positioned  %5u", component_count(COMP_POSITION)));
+		perf_overlay_put_line(console, &y, 0xaaaaaaff, frame_string(" visible     %5u", component_count(COMP_VISIBILITY)));
+		perf_overlay_put_line(console, &y, 0xaaaaaaff, frame_string(" moving      %5u", component_count(COMP_MOVEMENT)));
+		perf_overlay_put_line(console, &y, 0xaaaaaaff, frame_string(" with health %5u", component_count(COMP_HEALTH)));
+		perf_overlay_put_line(console, &y, 0xaaaaaaff, frame_string(" animated    %5u", component_count(COMP_ANIMATION)));
+	}
+}
+
+/*
+Keeps the overlay on top of the given screen while it's showing, moving it
+off whichever screen it was on before.
+*/
+internal void
+perf_overlay_follow(UIScreen *screen)
+{
+	UIScreen *target = perfOverlayShowing ? screen : NULL;
+	if (perfOverlayScreen == target) {
+		return;
+	}
+
+	if (perfOverlayScreen != NULL) {
+		list_remove_element_with_data(perfOverlayScreen->views, perfOverlayView);
+	}
+	if (target != NULL) {
+		list_insert_after(target->views, list_tail(target->views), perfOverlayView);
+		view_mark_dirty(perfOverlayView);
+	}
+	perfOverlayScreen = target;
+
+	// Whatever is under the overlay has to be drawn again, with or without it
+	ui_damage(perfOverlayView->pixelRect);
+}
+
+internal void
+perf_overlay_toggle(UIScreen *screen)
+{
+	if (perfOverlayView == NULL) {
+		UIRect overlayRect = {0, 0, (16 * PERF_OVERLAY_WIDTH), (16 * PERF_OVERLAY_HEIGHT)};
+		perfOverlayView = view_new(overlayRect, PERF_OVERLAY_WIDTH, PERF_OVERLAY_HEIGHT,
+								   "./terminal16x16.png", 0, 0x00000000,
+								   true, render_perf_overlay_view);
+	}
+
+	perfOverlayShowing = !perfOverlayShowing;
+	perf_overlay_follow(screen);
+}
+
+#endif
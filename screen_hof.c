@@ -19,18 +19,21 @@ internal void handle_event_hof(UIScreen *activeScreen, SDL_Event event);
 internal UIScreen * 
 screen_show_hof() 
 {
-	List *views = list_new(NULL);
-
-	UIRect bgRect = {0, 0, (16 * BG_WIDTH), (16 * BG_HEIGHT)};
-	UIView *bgView = view_new(bgRect, BG_WIDTH, BG_HEIGHT, 
-							   "./terminal16x16.png", 0, 0x000000ff, 
-							   true, render_hof_bg_view);
-	list_insert_after(views, NULL, bgView);
-
-	UIScreen *hofScreen = calloc(1, sizeof(UIScreen));
-	hofScreen->views = views;
-	hofScreen->activeView = bgView;
-	hofScreen->handle_event = handle_event_hof;
+	local_persist UIScreen *hofScreen = NULL;
+	if (hofScreen == NULL) {
+		List *views = list_new(NULL);
+
+		UIRect bgRect = {0, 0, (16 * BG_WIDTH), (16 * BG_HEIGHT)};
+		UIView *bgView = view_new(bgRect, BG_WIDTH, BG_HEIGHT, 
+								   "./terminal16x16.png", 0, 0x000000ff, 
+								   true, render_hof_bg_view);
+		list_insert_after(views, NULL, bgView);
+
+		hofScreen = calloc(1, sizeof(UIScreen));
+		hofScreen->views = views;
+		hofScreen->activeView = bgView;
+		hofScreen->handle_event = handle_event_hof;
+	}
 
 	if (hofConfig == NULL) {
 		hofConfig = config_file_parse("hof.cfg");
@@ -56,13 +59,13 @@ render_hof_entries(Console *console) {
 		char *gems = config_entity_value(entity, "gems");
 		char *date = config_entity_value(entity, "date");
 
-		char *nameString = String_Create("%20s", name);
+		char *nameString = frame_string("%20s", name);
 		console_put_string_at(console, nameString, 16, y, 0xe2f442ff, 0x00000000);
-		char *dateString = String_Create("%10s", date);
+		char *dateString = frame_string("%10s", date);
 		console_put_string_at(console, dateString, 36, y, 0xeeeeeeff, 0x00000000);
-		char *levelString = String_Create("Level:%2s", level);
+		char *levelString = frame_string("Level:%2s", level);
 		console_put_string_at(console, levelString, 47, y, 0xffd700ff, 0x00000000);
-		char *gemString = String_Create("Gems:%s", gems);
+		char *gemString = frame_string("Gems:%s", gems);
 		console_put_string_at(console, gemString, 56, y, 0xdb99fcff, 0x00000000);
 
 		y += 2;
@@ -73,18 +76,19 @@ render_hof_entries(Console *console) {
 internal void 
 render_hof_bg_view(Console *console)  
 {
-	// We should load and process the bg image only once, not on each render
-	local_persist BitmapImage *bgImage = NULL;
-	local_persist AsciiImage *aiImage = NULL;
-	if (bgImage == NULL) {
-		bgImage = image_load_from_file("./launch.png");
-		aiImage = asciify_bitmap(console, bgImage);	
+	// The image loads in the background - the plain console stands in for it 
+	// until it's ready
+	local_persist ImageAsset *bgAsset = NULL;
+	if (bgAsset == NULL) {
+		bgAsset = asset_image("./launch.png");
 	}
 
-	if (asciiMode) {
-		view_draw_ascii_image_at(console, aiImage, 0, 0);
-	} else {
-		view_draw_image_at(console, bgImage, 0, 0);	
+	if (asset_image_ready(bgAsset)) {
+		if (asciiMode) {
+			view_draw_ascii_image_at(console, bgAsset->asciiImage, 0, 0);
+		} else {
+			view_draw_image_at(console, bgAsset->image, 0, 0);	
+		}
 	}
 
 	UIRect rect = {10, 5, 60, 34};
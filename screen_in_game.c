@@ -16,15 +16,32 @@
 #define INVENTORY_WIDTH		40
 #define INVENTORY_HEIGHT	30
 
-
+// Every kind of terrain tile, pre-rasterized for one map view. Each 
+// TerrainType gets a row of the image, lit on the left and remembered 
+// (faded) on the right. Tile definitions never change, so it's built once.
+typedef struct {
+	BitmapImage *image;
+} TerrainLayer;
+
+
+global_variable UIScreen *inGameScreen = NULL;
+global_variable UIView *asciiMapView = NULL;
+global_variable UIView *graphicMapView = NULL;
+global_variable ListElement *mapViewElement = NULL;
 global_variable UIView *inventoryView = NULL;
+global_variable UIView *statsView = NULL;
+global_variable UIView *logView = NULL;
 global_variable i32 highlightedIdx = 0;
+global_variable TerrainLayer asciiTerrain = {0};
+global_variable TerrainLayer graphicTerrain = {0};
 
 
 internal void render_game_map_view(Console *console);
 internal void render_message_log_view(Console *console);
 internal void render_stats_view(Console *console);
+internal void render_inventory_view(Console *console);
 internal void handle_event_in_game(UIScreen *activeScreen, SDL_Event event);
+internal void in_game_use_tileset();
 
 
 // Init / Show screen --
@@ -32,42 +49,56 @@ internal void handle_event_in_game(UIScreen *activeScreen, SDL_Event event);
 internal UIScreen * 
 screen_show_in_game() 
 {
-	List *igViews = list_new(NULL);
-
-	UIRect mapRect = {0, 0, (16 * MAP_WIDTH), (16 * MAP_HEIGHT)};
-	char *tileset;
-	bool colorize = true;
-	u32 bgColor;
-	if (asciiMode) {
-		tileset = "./terminal16x16.png";
-		colorize = true;
-		bgColor = 0x000000ff;
-	} else {
-		tileset = "./graphic16x16.png";
-		colorize = false;
-		bgColor = 0x00000000;
-	}
-	UIView *mapView = view_new(mapRect, MAP_WIDTH, MAP_HEIGHT, 
-							   tileset, 0, bgColor,
-							   colorize, render_game_map_view);
-	list_insert_after(igViews, NULL, mapView);
-
-	UIRect statsRect = {0, (16 * MAP_HEIGHT), (16 * STATS_WIDTH), (16 * STATS_HEIGHT)};
-	UIView *statsView = view_new(statsRect, STATS_WIDTH, STATS_HEIGHT,
+	// The screen and all of its views are only built once, and reused 
+	// every time we come back to the game
+	if (inGameScreen == NULL) {
+		List *igViews = list_new(NULL);
+
+		// Build the map view for both tilesets up front, so switching 
+		// between them is instant
+		UIRect mapRect = {0, 0, (16 * MAP_WIDTH), (16 * MAP_HEIGHT)};
+		asciiMapView = view_new(mapRect, MAP_WIDTH, MAP_HEIGHT, 
+								"./terminal16x16.png", 0, 0x000000ff,
+								true, render_game_map_view);
+		graphicMapView = view_new(mapRect, MAP_WIDTH, MAP_HEIGHT, 
+								  "./graphic16x16.png", 0, 0x00000000,
+								  false, render_game_map_view);
+		list_insert_after(igViews, NULL, asciiMapView);
+		mapViewElement = list_head(igViews);
+
+		UIRect statsRect = {0, (16 * MAP_HEIGHT), (16 * STATS_WIDTH), (16 * STATS_HEIGHT)};
+		statsView = view_new(statsRect, STATS_WIDTH, STATS_HEIGHT,
+							 "./terminal16x16.png", 0, 0x000000ff,
+							 true, render_stats_view);
+		statsView->onDemand = true;
+		list_insert_after(igViews, NULL, statsView);
+
+		UIRect logRect = {(16 * 20), (16 * MAP_HEIGHT), (16 * LOG_WIDTH), (16 * LOG_HEIGHT)};
+		logView = view_new(logRect, LOG_WIDTH, LOG_HEIGHT,
+						   "./terminal16x16.png", 0, 0x000000ff,
+						   true, render_message_log_view);
+		logView->onDemand = true;
+		list_insert_after(igViews, NULL, logView);
+
+		// The inventory overlay sits on top of everything, hidden until needed
+		UIRect overlayRect = {(16 * INVENTORY_LEFT), (16 * INVENTORY_TOP), (16 * INVENTORY_WIDTH), (16 * INVENTORY_HEIGHT)};
+		inventoryView = view_new(overlayRect, INVENTORY_WIDTH, INVENTORY_HEIGHT, 
 								 "./terminal16x16.png", 0, 0x000000ff,
-								 true, render_stats_view);
-	list_insert_after(igViews, NULL, statsView);
+								 true, render_inventory_view);
+		view_set_hidden(inventoryView, true);
+		list_insert_after(igViews, list_tail(igViews), inventoryView);
+
+		inGameScreen = calloc(1, sizeof(UIScreen));
+		inGameScreen->views = igViews;
+		inGameScreen->activeView = asciiMapView;
+		inGameScreen->handle_event = handle_event_in_game;
+	}
 
-	UIRect logRect = {(16 * 20), (16 * MAP_HEIGHT), (16 * LOG_WIDTH), (16 * LOG_HEIGHT)};
-	UIView *logView = view_new(logRect, LOG_WIDTH, LOG_HEIGHT,
-							   "./terminal16x16.png", 0, 0x000000ff,
-							   true, render_message_log_view);
-	list_insert_after(igViews, NULL, logView);
+	// The screen outlives each game, so don't bring the last one's inventory 
+	// back up with it
+	view_set_hidden(inventoryView, true);
 
-	UIScreen *inGameScreen = calloc(1, sizeof(UIScreen));
-	inGameScreen->views = igViews;
-	inGameScreen->activeView = mapView;
-	inGameScreen->handle_event = handle_event_in_game;
+	in_game_use_tileset();
 
 	return inGameScreen;
 }
@@ -75,37 +106,85 @@ screen_show_in_game()
 
 // Render Functions --
 
+internal void
+map_put_glyph(Console *console, asciiChar glyph, u32 fgColor, u32 bgColor, u32 x, u32 y, bool inFOV)
+{
+	if (inFOV) {
+		console_put_char_at(console, glyph, x, y, fgColor, bgColor);
+	} else {
+		u32 fadedColor = COLOR_FROM_RGBA(RED(fgColor), GREEN(fgColor), BLUE(fgColor), 0x77);
+		console_put_char_at(console, glyph, x, y, fadedColor, 0x000000FF);
+	}
+}
+
+internal void
+terrain_layer_build(TerrainLayer *terrain, Console *console)
+{
+	terrain->image = calloc(1, sizeof(BitmapImage));
+	terrain->image->width = console->cellWidth * 2;
+	terrain->image->height = console->cellHeight * TERRAIN_TYPE_COUNT;
+	terrain->image->pixels = calloc(terrain->image->width * terrain->image->height, sizeof(u32));
+
+	// Draw them through a console of its own, set up like the map view's, 
+	// so they come out exactly as the map view would draw them
+	Console *terrainConsole = console_new(terrain->image->width, terrain->image->height, 
+										  TERRAIN_TYPE_COUNT, 2, console->bgColor, console->colorize, 
+										  terrain->image->pixels, terrain->image->width);
+	console_set_bitmap_font(terrainConsole, console->font->filename, console->font->firstCharInAtlas,
+							console->cellWidth, console->cellHeight);
+	for (u32 t = TERRAIN_NONE + 1; t < TERRAIN_TYPE_COUNT; t++) {
+		TileDefinition *def = &tileDefinitions[t];
+		map_put_glyph(terrainConsole, def->glyph, def->fgColor, def->bgColor, 0, t, true);
+		map_put_glyph(terrainConsole, def->glyph, def->fgColor, def->bgColor, 1, t, false);
+	}
+	console_rasterize(terrainConsole);
+	console_destroy(terrainConsole);
+}
+
 internal void 
 render_game_map_view(Console *console) 
 {
-	// Setup layer render history  
-	u8 layerRendered[MAP_WIDTH][MAP_HEIGHT];
-	for (u32 x = 0; x < MAP_WIDTH; x++) {
-		for (u32 y = 0; y < MAP_HEIGHT; y++) {
-			layerRendered[x][y] = LAYER_UNSET;
+	// The terminal backend only sees glyphs, so it gets the terrain as glyphs 
+	// too, rather than as slices of the terrain layer
+	TerrainLayer *terrain = NULL;
+	if (!terminal.active) {
+		terrain = (console == asciiMapView->console) ? &asciiTerrain : &graphicTerrain;
+		if (terrain->image == NULL) {
+			terrain_layer_build(terrain, console);
 		}
 	}
 
-	// Walk the visible element list for each layer, from ground to top
-	for (int layer = LAYER_GROUND; layer <= LAYER_TOP; layer++) {
-		ListElement *e = list_head(visibilityComps);
-		while (e != NULL) {
-			Visibility *vis = (Visibility *)list_data(e);
-			Position *p = (Position *)game_object_get_component(&gameObjects[vis->objectId], COMP_POSITION);
-			if (p != NULL && p->layer == layer) {
-				if (fovMap[p->x][p->y] > 0) {
-					vis->hasBeenSeen = true;
-					console_put_char_at(console, vis->glyph, p->x, p->y, vis->fgColor, vis->bgColor);
-					layerRendered[p->x][p->y] = p->layer;
-
-				} else if (vis->visibleOutsideFOV && vis->hasBeenSeen) {
-					u32 fullColor = vis->fgColor;
-					u32 fadedColor = COLOR_FROM_RGBA(RED(fullColor), GREEN(fullColor), BLUE(fullColor), 0x77);
-					console_put_char_at(console, vis->glyph, p->x, p->y, fadedColor, 0x000000FF);
-					layerRendered[p->x][p->y] = p->layer;
+	// Draw each cell once: its wall or floor, then whatever is on top of it 
+	// in each layer, from the render index the game keeps. Terrain, once 
+	// seen, is remembered out of view, as are objects that are visible 
+	// outside the FOV, even when something else has since landed on them.
+	for (u32 y = 0; y < MAP_HEIGHT; y++) {
+		for (u32 x = 0; x < MAP_WIDTH; x++) {
+			bool inFOV = (fovMap[x][y] > 0);
+			CellRenderIndex *cell = &renderIndex[y][x];
+
+			Tile *tile = &levelTerrain[x][y];
+			if (inFOV) {
+				tile->flags |= TILE_SEEN;
+				render_index_mark_cell_seen(x, y);
+			}
+			if ((tile->type != TERRAIN_NONE) && (tile->flags & TILE_SEEN)) {
+				if (terrain == NULL) {
+					TileDefinition *def = &tileDefinitions[tile->type];
+					map_put_glyph(console, def->glyph, def->fgColor, def->bgColor, x, y, inFOV);
+				} else {
+					u32 imageX = inFOV ? 0 : console->cellWidth;
+					console_put_image_cell_at(console, terrain->image, imageX, tile->type * console->cellHeight, x, y);
+				}
+			}
+
+			for (u32 layer = 0; layer < LAYER_COUNT; layer++) {
+				GameObject *go = inFOV ? cell->layers[layer] : cell->remembered[layer];
+				if (go != NULL) {
+					Visibility *vis = (Visibility *)game_object_get_component(go, COMP_VISIBILITY);
+					map_put_glyph(console, vis->glyph, vis->fgColor, vis->bgColor, x, y, inFOV);
 				}
 			}
-			e = list_next(e);
 		}
 	}
 }
@@ -116,18 +195,19 @@ render_inventory_view(Console *console)
 	UIRect rect = {0, 0, INVENTORY_WIDTH, INVENTORY_HEIGHT};
 	view_draw_rect(console, &rect, 0x222222FF, 0, 0xFF990099);
 
-	// We should load and process the bg image only once, not on each render
-	local_persist BitmapImage *bgImage = NULL;
-	local_persist AsciiImage *aiImage = NULL;
-	if (bgImage == NULL) {
-		bgImage = image_load_from_file("./scrollBackground.png");
-		aiImage = asciify_bitmap(console, bgImage);	
+	// The image loads in the background - the plain console stands in for it 
+	// until it's ready
+	local_persist ImageAsset *bgAsset = NULL;
+	if (bgAsset == NULL) {
+		bgAsset = asset_image("./scrollBackground.png");
 	}
 
-	if (asciiMode) {
-		view_draw_ascii_image_at(console, aiImage, 0, 0);
-	} else {
-		view_draw_image_at(console, bgImage, 0, 0);	
+	if (asset_image_ready(bgAsset)) {
+		if (asciiMode) {
+			view_draw_ascii_image_at(console, bgAsset->asciiImage, 0, 0);
+		} else {
+			view_draw_image_at(console, bgAsset->image, 0, 0);	
+		}
 	}
 
 
@@ -142,8 +222,8 @@ render_inventory_view(Console *console)
 		Equipment *eq = game_object_get_component(go, COMP_EQUIPMENT);
 		if (v != NULL && eq != NULL) {
 			char *equipped = (eq->isEquipped) ? "*" : ".";
-			char *slotStr = String_Create("[%s]", eq->slot);
-			char *itemText = String_Create("%s %-10s %-8s wt: %d", equipped, v->name, slotStr, eq->weight);
+			char *slotStr = frame_string("[%s]", eq->slot);
+			char *itemText = frame_string("%s %-10s %-8s wt: %d", equipped, v->name, slotStr, eq->weight);
 			if (currIdx == highlightedIdx) {
 				if (eq->isEquipped) {
 					console_put_string_at(console, itemText, 6, yIdx, 0x98FB98ff, 0x80000099);
@@ -164,13 +244,11 @@ render_inventory_view(Console *console)
 	}
 
 	// Render additional information at bottom of view
-	char *weightInfo = String_Create("Carrying: %d  Max: %d", item_get_weight_carried(), maxWeightAllowed);
+	char *weightInfo = frame_string("Carrying: %d  Max: %d", item_get_weight_carried(), maxWeightAllowed);
 	console_put_string_at(console, weightInfo, 10, 23, 0x000044ff, 0x00000000);
 
-	char *instructions = String_Create("[Up/Down] to select item");
-	char *i2 = String_Create("[Spc] to (un)equip, [D] to drop");
-	console_put_string_at(console, instructions, 5, 25, 0x333333ff, 0x00000000);
-	console_put_string_at(console, i2, 5, 26, 0x333333ff, 0x00000000);
+	console_put_string_at(console, "[Up/Down] to select item", 5, 25, 0x333333ff, 0x00000000);
+	console_put_string_at(console, "[Spc] to (un)equip, [D] to drop", 5, 26, 0x333333ff, 0x00000000);
 }
 
 internal void 
@@ -235,47 +313,64 @@ render_stats_view(Console *console)
 	}
 
 	Combat *playerCombat = game_object_get_component(player, COMP_COMBAT);
-	char *att = String_Create("ATT:%d (%d)", playerCombat->attack, playerCombat->attackModifier);
+	char *att = frame_string("ATT:%d (%d)", playerCombat->attack, playerCombat->attackModifier);
 	console_put_string_at(console, att, 0, 2, 0xe6e600FF, 0x00000000);
-	String_Destroy(att);
 
-	char *def = String_Create("DEF:%d (%d)", playerCombat->defense, playerCombat->defenseModifier);
+	char *def = frame_string("DEF:%d (%d)", playerCombat->defense, playerCombat->defenseModifier);
 	console_put_string_at(console, def, 0, 3, 0xe6e600FF, 0x00000000);
-	String_Destroy(def);
 
-	char *level = String_Create("Level:%d", currentLevelNumber);
+	char *level = frame_string("Level:%d", currentLevelNumber);
 	console_put_string_at(console, level, 0, 4, 0xffd700ff, 0x00000000);
-	String_Destroy(level);
 
-	char *gems = String_Create("Gems:%d", gemsFoundTotal);
+	char *gems = frame_string("Gems:%d", gemsFoundTotal);
 	console_put_string_at(console, gems, 10, 4, 0x753aabff, 0x00000000);
-	String_Destroy(gems);
 
 }
 
 
 // Screen Functions
 
-internal void 
-hide_inventory_overlay(UIScreen *screen) 
+internal void
+in_game_mark_stats_dirty()
+{
+	view_mark_dirty(statsView);
+}
+
+internal void
+in_game_mark_log_dirty()
 {
-	if (inventoryView != NULL) {
-		list_remove_element_with_data(screen->views, inventoryView);
-		view_destroy(inventoryView);
-		inventoryView = NULL;
+	view_mark_dirty(logView);
+}
+
+internal void
+in_game_use_tileset()
+{
+	// Swap in the map view matching the current ASCII mode
+	UIView *mapView = asciiMode ? asciiMapView : graphicMapView;
+	if (mapViewElement->data != mapView) {
+		mapViewElement->data = mapView;
+		inGameScreen->activeView = mapView;
+		view_mark_dirty(mapView);
+		ui_damage(mapView->pixelRect);
 	}
 }
 
+internal bool
+inventory_is_showing()
+{
+	return !inventoryView->hidden;
+}
+
 internal void 
-show_inventory_overlay(UIScreen *screen) 
+hide_inventory_overlay() 
 {
-	if (inventoryView == NULL) {
-		UIRect overlayRect = {(16 * INVENTORY_LEFT), (16 * INVENTORY_TOP), (16 * INVENTORY_WIDTH), (16 * INVENTORY_HEIGHT)};
-		inventoryView = view_new(overlayRect, INVENTORY_WIDTH, INVENTORY_HEIGHT, 
-								   "./terminal16x16.png", 0, 0x000000ff,
-								   true, render_inventory_view);
-		list_insert_after(screen->views, list_tail(screen->views), inventoryView);
-	}
+	view_set_hidden(inventoryView, true);
+}
+
+internal void 
+show_inventory_overlay() 
+{
+	view_set_hidden(inventoryView, false);
 }
 
 
@@ -284,6 +379,7 @@ show_inventory_overlay(UIScreen *screen)
 internal void
 handle_event_in_game(UIScreen *activeScreen, SDL_Event event) 
 {
+	(void)activeScreen;		// always inGameScreen
 
 	if (event.type == SDL_KEYDOWN) {
 		SDL_Keycode key = event.key.keysym.sym;
@@ -309,7 +405,7 @@ handle_event_in_game(UIScreen *activeScreen, SDL_Event event)
 			// END DEBUG
 
 			case SDLK_UP: {
-				if (inventoryView != NULL) {
+				if (inventory_is_showing()) {
 					// Handle for inventory view
 					highlightedIdx -= 1;
 					if (highlightedIdx < 0) { highlightedIdx = 0; }
@@ -324,17 +420,15 @@ handle_event_in_game(UIScreen *activeScreen, SDL_Event event)
 
 					} else {
 						// Check to see what is blocking movement. If NPC - resolve combat!
-						List *blockers = game_objects_at_position(playerPos->x, playerPos->y - 1);
 						GameObject *blockerObj = NULL;
-						ListElement *e = list_head(blockers);
-						while (e != NULL) {
-							GameObject *go = (GameObject *)list_data(e);
+						GameObject *go = game_objects_at_position(playerPos->x, playerPos->y - 1);
+						while (go != NULL) {
 							Combat *cc = (Combat *)game_object_get_component(go, COMP_COMBAT);
 							if (cc != NULL) {
 								blockerObj = go;
 								break;
 							}
-							e = list_next(e);
+							go = game_object_next_at_position(go);
 						}
 						if (blockerObj != NULL) {
 							combat_attack(player, blockerObj);
@@ -346,7 +440,7 @@ handle_event_in_game(UIScreen *activeScreen, SDL_Event event)
 			break;
 
 			case SDLK_DOWN: {
-				if (inventoryView != NULL) {
+				if (inventory_is_showing()) {
 					// Handle for inventory view
 					highlightedIdx += 1;
 					if (highlightedIdx > list_size(carriedItems)-1) { highlightedIdx = list_size(carriedItems) - 1; }
@@ -360,17 +454,15 @@ handle_event_in_game(UIScreen *activeScreen, SDL_Event event)
 						playerTookTurn = true;		
 					} else {
 						// Check to see what is blocking movement. If NPC - resolve combat!
-						List *blockers = game_objects_at_position(playerPos->x, playerPos->y + 1);
 						GameObject *blockerObj = NULL;
-						ListElement *e = list_head(blockers);
-						while (e != NULL) {
-							GameObject *go = (GameObject *)list_data(e);
+						GameObject *go = game_objects_at_position(playerPos->x, playerPos->y + 1);
+						while (go != NULL) {
 							Combat *cc = (Combat *)game_object_get_component(go, COMP_COMBAT);
 							if (cc != NULL) {
 								blockerObj = go;
 								break;
 							}
-							e = list_next(e);
+							go = game_object_next_at_position(go);
 						}
 						if (blockerObj != NULL) {
 							combat_attack(player, blockerObj);
@@ -389,17 +481,15 @@ handle_event_in_game(UIScreen *activeScreen, SDL_Event event)
 					playerTookTurn = true;		
 				} else {
 					// Check to see what is blocking movement. If NPC - resolve combat!
-					List *blockers = game_objects_at_position(playerPos->x - 1, playerPos->y);
 					GameObject *blockerObj = NULL;
-					ListElement *e = list_head(blockers);
-					while (e != NULL) {
-						GameObject *go = (GameObject *)list_data(e);
+					GameObject *go = game_objects_at_position(playerPos->x - 1, playerPos->y);
+					while (go != NULL) {
 						Combat *cc = (Combat *)game_object_get_component(go, COMP_COMBAT);
 						if (cc != NULL) {
 							blockerObj = go;
 							break;
 						}
-						e = list_next(e);
+						go = game_object_next_at_position(go);
 					}
 					if (blockerObj != NULL) {
 						combat_attack(player, blockerObj);
@@ -418,17 +508,15 @@ handle_event_in_game(UIScreen *activeScreen, SDL_Event event)
 
 				} else {
 					// Check to see what is blocking movement. If NPC - resolve combat!
-					List *blockers = game_objects_at_position(playerPos->x + 1, playerPos->y);
 					GameObject *blockerObj = NULL;
-					ListElement *e = list_head(blockers);
-					while (e != NULL) {
-						GameObject *go = (GameObject *)list_data(e);
+					GameObject *go = game_objects_at_position(playerPos->x + 1, playerPos->y);
+					while (go != NULL) {
 						Combat *cc = (Combat *)game_object_get_component(go, COMP_COMBAT);
 						if (cc != NULL) {
 							blockerObj = go;
 							break;
 						}
-						e = list_next(e);
+						go = game_object_next_at_position(go);
 					}
 					if (blockerObj != NULL) {
 						combat_attack(player, blockerObj);
@@ -439,7 +527,7 @@ handle_event_in_game(UIScreen *activeScreen, SDL_Event event)
 			break;
 
 			case SDLK_d: {
-				if (inventoryView != NULL) {
+				if (inventory_is_showing()) {
 					ListElement *le = list_item_at(carriedItems, highlightedIdx);
 					if (le != NULL) {
 						item_drop(le->data);
@@ -452,7 +540,7 @@ handle_event_in_game(UIScreen *activeScreen, SDL_Event event)
 			break;
 
 			case SDLK_e: {
-				if (inventoryView != NULL) {
+				if (inventory_is_showing()) {
 					ListElement *le = list_item_at(carriedItems, highlightedIdx);
 					if (le != NULL) {
 						item_toggle_equip(le->data);
@@ -470,10 +558,10 @@ handle_event_in_game(UIScreen *activeScreen, SDL_Event event)
 			break;
 
 			case SDLK_i: {
-				if (inventoryView == NULL) {
-					show_inventory_overlay(activeScreen);				
+				if (inventory_is_showing()) {
+					hide_inventory_overlay();
 				} else {
-					hide_inventory_overlay(activeScreen);
+					show_inventory_overlay();
 				}
 			}
 			break;
@@ -487,7 +575,7 @@ handle_event_in_game(UIScreen *activeScreen, SDL_Event event)
 
 			case SDLK_SPACE: {
 				// Same as equip
-				if (inventoryView != NULL) {
+				if (inventory_is_showing()) {
 					ListElement *le = list_item_at(carriedItems, highlightedIdx);
 					if (le != NULL) {
 						item_toggle_equip(le->data);
@@ -497,8 +585,8 @@ handle_event_in_game(UIScreen *activeScreen, SDL_Event event)
 			break;
 
 			case SDLK_ESCAPE: {
-				if (inventoryView != NULL) {
-					hide_inventory_overlay(activeScreen);
+				if (inventory_is_showing()) {
+					hide_inventory_overlay();
 				} else {
 					quit_game();
 				}
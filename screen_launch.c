@@ -28,24 +28,27 @@ internal UIScreen * screen_show_hof();
 internal UIScreen * 
 screen_show_launch() 
 {
-	List *launchViews = list_new(NULL);
-
-	UIRect menuRect = {(16 * MENU_LEFT), (16 * MENU_TOP), (16 * MENU_WIDTH), (16 * MENU_HEIGHT)};
-	UIView *menuView = view_new(menuRect, MENU_WIDTH, MENU_HEIGHT,
-								 "./terminal16x16.png", 0, 0x000000ff,
-								 true, render_menu_view);
-	list_insert_after(launchViews, NULL, menuView);
-
-	UIRect bgRect = {0, 0, (16 * BG_WIDTH), (16 * BG_HEIGHT)};
-	UIView *bgView = view_new(bgRect, BG_WIDTH, BG_HEIGHT, 
-							   "./terminal16x16.png", 0, 0x000000ff,
-							   true, render_bg_view);
-	list_insert_after(launchViews, NULL, bgView);
-
-	UIScreen *launchScreen = calloc(1, sizeof(UIScreen));
-	launchScreen->views = launchViews;
-	launchScreen->activeView = menuView;
-	launchScreen->handle_event = handle_event_launch;
+	local_persist UIScreen *launchScreen = NULL;
+	if (launchScreen == NULL) {
+		List *launchViews = list_new(NULL);
+
+		UIRect menuRect = {(16 * MENU_LEFT), (16 * MENU_TOP), (16 * MENU_WIDTH), (16 * MENU_HEIGHT)};
+		UIView *menuView = view_new(menuRect, MENU_WIDTH, MENU_HEIGHT,
+									 "./terminal16x16.png", 0, 0x000000ff,
+									 true, render_menu_view);
+		list_insert_after(launchViews, NULL, menuView);
+
+		UIRect bgRect = {0, 0, (16 * BG_WIDTH), (16 * BG_HEIGHT)};
+		UIView *bgView = view_new(bgRect, BG_WIDTH, BG_HEIGHT, 
+								   "./terminal16x16.png", 0, 0x000000ff,
+								   true, render_bg_view);
+		list_insert_after(launchViews, NULL, bgView);
+
+		launchScreen = calloc(1, sizeof(UIScreen));
+		launchScreen->views = launchViews;
+		launchScreen->activeView = menuView;
+		launchScreen->handle_event = handle_event_launch;
+	}
 
 	return launchScreen;
 }
@@ -56,18 +59,19 @@ screen_show_launch()
 internal void 
 render_bg_view(Console *console)  
 {
-	// We should load and process the bg image only once, not on each render
-	local_persist BitmapImage *bgImage = NULL;
-	local_persist AsciiImage *aiImage = NULL;
-	if (bgImage == NULL) {
-		bgImage = image_load_from_file("./launch.png");
-		aiImage = asciify_bitmap(console, bgImage);	
+	// The image loads in the background - the plain console stands in for it 
+	// until it's ready
+	local_persist ImageAsset *bgAsset = NULL;
+	if (bgAsset == NULL) {
+		bgAsset = asset_image("./launch.png");
 	}
 
-	if (asciiMode) {
-		view_draw_ascii_image_at(console, aiImage, 0, 0);
-	} else {
-		view_draw_image_at(console, bgImage, 0, 0);	
+	if (asset_image_ready(bgAsset)) {
+		if (asciiMode) {
+			view_draw_ascii_image_at(console, bgAsset->asciiImage, 0, 0);
+		} else {
+			view_draw_image_at(console, bgAsset->image, 0, 0);	
+		}
 	}
 
 	console_put_string_at(console, "Dark Caverns", 52, 18, 0x556d76FF, 0x00000000);
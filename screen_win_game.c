@@ -24,24 +24,27 @@ internal void handle_event_win(UIScreen *activeScreen, SDL_Event event);
 internal UIScreen * 
 screen_show_win_game() 
 {
-	List *views = list_new(NULL);
-
-	UIRect infoRect = {(16 * WIN_INFO_LEFT), (16 * WIN_INFO_TOP), (16 * WIN_INFO_WIDTH), (16 * WIN_INFO_HEIGHT)};
-	UIView *infoView = view_new(infoRect, WIN_INFO_WIDTH, WIN_INFO_HEIGHT,
-								 "./terminal16x16.png", 0, 0x00000000, 
-                                 true, render_win_info_view);
-	list_insert_after(views, NULL, infoView);
-
-	UIRect bgRect = {0, 0, (16 * BG_WIDTH), (16 * BG_HEIGHT)};
-	UIView *bgView = view_new(bgRect, BG_WIDTH, BG_HEIGHT, 
-							   "./terminal16x16.png", 0, 0x000000ff,
-                               true, render_win_bg_view);
-	list_insert_after(views, NULL, bgView);
-
-	UIScreen *winScreen = calloc(1, sizeof(UIScreen));
-	winScreen->views = views;
-	winScreen->activeView = bgView;
-	winScreen->handle_event = handle_event_win;
+	local_persist UIScreen *winScreen = NULL;
+	if (winScreen == NULL) {
+		List *views = list_new(NULL);
+
+		UIRect infoRect = {(16 * WIN_INFO_LEFT), (16 * WIN_INFO_TOP), (16 * WIN_INFO_WIDTH), (16 * WIN_INFO_HEIGHT)};
+		UIView *infoView = view_new(infoRect, WIN_INFO_WIDTH, WIN_INFO_HEIGHT,
+									 "./terminal16x16.png", 0, 0x00000000, 
+	                                 true, render_win_info_view);
+		list_insert_after(views, NULL, infoView);
+
+		UIRect bgRect = {0, 0, (16 * BG_WIDTH), (16 * BG_HEIGHT)};
+		UIView *bgView = view_new(bgRect, BG_WIDTH, BG_HEIGHT, 
+								   "./terminal16x16.png", 0, 0x000000ff,
+	                               true, render_win_bg_view);
+		list_insert_after(views, NULL, bgView);
+
+		winScreen = calloc(1, sizeof(UIScreen));
+		winScreen->views = views;
+		winScreen->activeView = bgView;
+		winScreen->handle_event = handle_event_win;
+	}
 
 	return winScreen;
 }
@@ -52,18 +55,19 @@ screen_show_win_game()
 internal void 
 render_win_bg_view(Console *console)  
 {
-	// We should load and process the bg image only once, not on each render
-	local_persist BitmapImage *bgImage = NULL;
-	local_persist AsciiImage *aiImage = NULL;
-	if (bgImage == NULL) {
-		bgImage = image_load_from_file("./you_won.png");
-		aiImage = asciify_bitmap(console, bgImage);	
+	// The image loads in the background - the plain console stands in for it 
+	// until it's ready
+	local_persist ImageAsset *bgAsset = NULL;
+	if (bgAsset == NULL) {
+		bgAsset = asset_image("./you_won.png");
 	}
 
-	if (asciiMode) {
-		view_draw_ascii_image_at(console, aiImage, 0, 0);
-	} else {
-		view_draw_image_at(console, bgImage, 0, 0);	
+	if (asset_image_ready(bgAsset)) {
+		if (asciiMode) {
+			view_draw_ascii_image_at(console, bgAsset->asciiImage, 0, 0);
+		} else {
+			view_draw_image_at(console, bgAsset->image, 0, 0);	
+		}
 	}
 
     console_put_string_at(console, "Your hero is teleported back to the surface safely!", 3, 10, 0x0000bbff, 0x00000000);
@@ -78,13 +82,11 @@ render_win_info_view(Console *console)
 
 	console_put_string_at(console, playerName, 18, 2, 0xffffffff, 0x00000000);
 
-	char *level = String_Create("Level:%d", 20);
+	char *level = frame_string("Level:%d", 20);
 	console_put_string_at(console, level, 18, 4, 0xffd700ff, 0x00000000);
-	String_Destroy(level);
 
-	char *gems = String_Create("Gems:%d", gemsFoundTotal);
+	char *gems = frame_string("Gems:%d", gemsFoundTotal);
 	console_put_string_at(console, gems, 28, 4, 0x753aabff, 0x00000000);
-	String_Destroy(gems);
 
 	// Instructions for active commands
 	console_put_string_at(console, "View the (H)all of Fame", 16, 9, 0xbca285FF, 0x00000000);
@@ -0,0 +1,357 @@
+/*
+* spatial.c - Finding what's near a place on the map
+*
+* Every query walks the per-cell object chains in game.c over just the
+* cells it covers, so its cost depends on the size of the area and not on
+* how many objects there are in the level. Results go into a buffer the
+* caller provides - nothing is allocated.
+*/
+
+// A set of components an object must have all of, to be found. 0 finds
+// everything.
+typedef u32 ComponentMask;
+
+#define COMPONENT_BIT(comp)		(1u << (comp))
+
+// Any radius this big covers the whole map, wherever it's measured from
+#define SPATIAL_RADIUS_MAX		(MAP_WIDTH + MAP_HEIGHT)
+
+typedef enum {
+	SPATIAL_CHEBYSHEV,		// squares - a move in any of the 8 directions is 1
+	SPATIAL_EUCLIDEAN,		// circles
+} SpatialMetric;
+
+typedef bool (*SpatialPredicate)(GameObject *obj, void *context);
+
+// Where each origin's results went in a batched query's shared buffer
+typedef struct {
+	u32 first;
+	u32 count;
+} SpatialBatchRange;
+
+// How far a radius reaches along each row, from dy = -radius to +radius.
+// Worked out once per radius, and shared by every origin in a batch.
+typedef struct {
+	i32 radius;
+	i32 halfWidth[(2 * SPATIAL_RADIUS_MAX) + 1];
+} SpatialSpans;
+
+
+internal bool
+spatial_object_matches(GameObject *obj, ComponentMask mask) {
+	for (u32 c = 0; c < COMPONENT_COUNT; c++) {
+		if ((mask & COMPONENT_BIT(c)) && (obj->components[c] == COMPONENT_NONE)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+Adds the matching objects in one cell to results, most recent arrival first.
+Keeps counting once results is full.
+*/
+internal void
+spatial_collect_cell(i32 x, i32 y, ComponentMask mask, GameObject **results, u32 maxResults, u32 *count) {
+	GameObject *go = game_objects_at_position(x, y);
+	while (go != NULL) {
+		if (spatial_object_matches(go, mask)) {
+			if (*count < maxResults) {
+				results[*count] = go;
+			}
+			*count += 1;
+		}
+		go = game_object_next_at_position(go);
+	}
+}
+
+internal void
+spatial_spans_init(SpatialSpans *spans, u32 radius, SpatialMetric metric) {
+	spans->radius = (radius < SPATIAL_RADIUS_MAX) ? radius : SPATIAL_RADIUS_MAX;
+	i32 r = spans->radius;
+	for (i32 dy = -r; dy <= r; dy++) {
+		i32 w = r;
+		if (metric == SPATIAL_EUCLIDEAN) {
+			// Widest that's still inside the circle
+			w = 0;
+			while (((w + 1) * (w + 1)) + (dy * dy) <= (r * r)) {
+				w += 1;
+			}
+		}
+		spans->halfWidth[dy + r] = w;
+	}
+}
+
+internal u32
+spatial_collect_spans(i32 originX, i32 originY, SpatialSpans *spans, ComponentMask mask,
+					  GameObject **results, u32 maxResults) {
+	u32 count = 0;
+	i32 r = spans->radius;
+	for (i32 dy = -r; dy <= r; dy++) {
+		i32 y = originY + dy;
+		if ((y < 0) || (y >= MAP_HEIGHT)) { continue; }
+
+		i32 w = spans->halfWidth[dy + r];
+		i32 minX = (originX - w < 0) ? 0 : originX - w;
+		i32 maxX = (originX + w >= MAP_WIDTH) ? MAP_WIDTH - 1 : originX + w;
+		for (i32 x = minX; x <= maxX; x++) {
+			spatial_collect_cell(x, y, mask, results, maxResults, &count);
+		}
+	}
+	return count;
+}
+
+/*
+Finds the objects within radius of the origin, by the given metric, that
+have every component in mask. Up to maxResults of them are written to
+results, row by row from the top. Returns how many there are in all, which
+may be more than maxResults.
+*/
+u32 spatial_query_radius(i32 originX, i32 originY, u32 radius, SpatialMetric metric,
+						 ComponentMask mask, GameObject **results, u32 maxResults) {
+	SpatialSpans spans;
+	spatial_spans_init(&spans, radius, metric);
+	return spatial_collect_spans(originX, originY, &spans, mask, results, maxResults);
+}
+
+/*
+As spatial_query_radius, for many origins at once. Every origin's results
+go into the one buffer, one after another, and ranges[i] says where the
+results for origins[i] are. Returns how many were found in all - if that's
+more than maxResults, the later origins' ranges have been cut short.
+*/
+u32 spatial_query_radius_batch(Point *origins, u32 originCount, u32 radius, SpatialMetric metric,
+							   ComponentMask mask, GameObject **results, u32 maxResults,
+							   SpatialBatchRange *ranges) {
+	SpatialSpans spans;
+	spatial_spans_init(&spans, radius, metric);
+
+	u32 total = 0;
+	for (u32 i = 0; i < originCount; i++) {
+		u32 first = (total < maxResults) ? total : maxResults;
+		u32 found = spatial_collect_spans(origins[i].x, origins[i].y, &spans, mask,
+										  &results[first], maxResults - first);
+		ranges[i].first = first;
+		ranges[i].count = (found < maxResults - first) ? found : maxResults - first;
+		total += found;
+	}
+	return total;
+}
+
+/*
+Finds the objects inside rect, in map cells, that have every component in
+mask. Results are as for spatial_query_radius.
+*/
+u32 spatial_query_rect(UIRect *rect, ComponentMask mask, GameObject **results, u32 maxResults) {
+	i32 minX = (rect->x < 0) ? 0 : rect->x;
+	i32 minY = (rect->y < 0) ? 0 : rect->y;
+	i32 maxX = (rect->x + rect->w > MAP_WIDTH) ? MAP_WIDTH : rect->x + rect->w;
+	i32 maxY = (rect->y + rect->h > MAP_HEIGHT) ? MAP_HEIGHT : rect->y + rect->h;
+
+	u32 count = 0;
+	for (i32 y = minY; y < maxY; y++) {
+		for (i32 x = minX; x < maxX; x++) {
+			spatial_collect_cell(x, y, mask, results, maxResults, &count);
+		}
+	}
+	return count;
+}
+
+/*
+Returns the object closest to the origin, by the given metric and no further
+than maxRadius, that predicate accepts - or NULL if there isn't one. A NULL
+predicate accepts anything. Searches outwards a ring of cells at a time, so
+nearby objects are found without looking any further.
+*/
+GameObject *spatial_query_nearest(i32 originX, i32 originY, u32 maxRadius, SpatialMetric metric,
+								  SpatialPredicate predicate, void *context) {
+	i32 maxR = (maxRadius < SPATIAL_RADIUS_MAX) ? maxRadius : SPATIAL_RADIUS_MAX;
+	GameObject *nearest = NULL;
+	i32 nearestDistSq = 0;
+
+	for (i32 r = 0; r <= maxR; r++) {
+		// The ring of cells exactly r away, by Chebyshev distance
+		for (i32 dy = -r; dy <= r; dy++) {
+			i32 y = originY + dy;
+			if ((y < 0) || (y >= MAP_HEIGHT)) { continue; }
+
+			bool edgeRow = ((dy == -r) || (dy == r));
+			i32 step = edgeRow ? 1 : (2 * r);
+			for (i32 dx = -r; dx <= r; dx += step) {
+				i32 x = originX + dx;
+				if ((x < 0) || (x >= MAP_WIDTH)) { continue; }
+
+				i32 distSq = (dx * dx) + (dy * dy);
+				if ((metric == SPATIAL_EUCLIDEAN) &&
+					((distSq > maxR * maxR) || ((nearest != NULL) && (distSq >= nearestDistSq)))) {
+					continue;
+				}
+
+				GameObject *go = game_objects_at_position(x, y);
+				while (go != NULL) {
+					if ((predicate == NULL) || predicate(go, context)) {
+						nearest = go;
+						nearestDistSq = distSq;
+						break;
+					}
+					go = game_object_next_at_position(go);
+				}
+				if ((nearest != NULL) && (metric == SPATIAL_CHEBYSHEV)) {
+					return nearest;
+				}
+			}
+		}
+
+		// Nothing in a further ring can be closer than r + 1
+		if ((nearest != NULL) && (nearestDistSq <= (r + 1) * (r + 1))) {
+			return nearest;
+		}
+	}
+	return nearest;
+}
+
+
+#ifdef DEBUG
+
+internal i32
+spatial_check_distance(SpatialMetric metric, i32 dx, i32 dy) {
+	// Squared for Euclidean, to compare with the radius squared
+	if (metric == SPATIAL_EUCLIDEAN) {
+		return (dx * dx) + (dy * dy);
+	}
+	dx = abs(dx);
+	dy = abs(dy);
+	return (dx > dy) ? dx : dy;
+}
+
+internal bool
+spatial_check_has_components(GameObject *obj, void *context) {
+	return spatial_object_matches(obj, *(ComponentMask *)context);
+}
+
+internal bool
+spatial_check_contains(GameObject **results, u32 count, GameObject *obj) {
+	for (u32 i = 0; i < count; i++) {
+		if (results[i] == obj) { return true; }
+	}
+	return false;
+}
+
+/*
+Runs every query from origins on, along the edge of, and off the map, and
+makes sure each finds exactly what a brute force scan of the Position store
+does, against whatever level is loaded. Uses a generator of its own, so the 
+game's rand() sequence is left alone.
+*/
+internal bool
+spatial_conformance_check() {
+	Position *positions = (Position *)component_array(COMP_POSITION);
+	u32 positionCount = component_count(COMP_POSITION);
+	GameObject **results = calloc(positionCount + 1, sizeof(GameObject *));
+	GameObject **expected = calloc(positionCount + 1, sizeof(GameObject *));
+
+	#define SPATIAL_CHECK_BATCH		8
+	#define SPATIAL_CHECK(condition)	if (!(condition)) { passed = false; }
+	bool passed = true;
+	Point origins[SPATIAL_CHECK_BATCH];
+	SpatialBatchRange ranges[SPATIAL_CHECK_BATCH];
+	GameObject **batchResults = calloc((positionCount * SPATIAL_CHECK_BATCH) + 1, sizeof(GameObject *));
+
+	u32 seed = 0x2545f491;
+	for (u32 q = 0; q < 500; q++) {
+		seed = (seed * 1664525) + 1013904223;
+		i32 originX = (i32)((seed >> 8) % (MAP_WIDTH + 10)) - 5;
+		seed = (seed * 1664525) + 1013904223;
+		i32 originY = (i32)((seed >> 8) % (MAP_HEIGHT + 10)) - 5;
+		seed = (seed * 1664525) + 1013904223;
+		u32 radius = (seed >> 8) % (SPATIAL_RADIUS_MAX + 5);
+		if (q & 2) { radius %= 12; }		// mostly the sizes actually asked for
+		SpatialMetric metric = (q & 1) ? SPATIAL_EUCLIDEAN : SPATIAL_CHEBYSHEV;
+		seed = (seed * 1664525) + 1013904223;
+		ComponentMask mask = ((q % 3) == 0) ? 0 : COMPONENT_BIT((seed >> 8) % COMPONENT_COUNT);
+		i32 limit = (metric == SPATIAL_EUCLIDEAN) ? (i32)(radius * radius) : (i32)radius;
+
+		// Radius
+		u32 expectedCount = 0;
+		i32 nearestDist = -1;
+		for (u32 i = 0; i < positionCount; i++) {
+			GameObject *go = game_object_get(positions[i].objectId);
+			i32 dist = spatial_check_distance(metric, positions[i].x - originX, positions[i].y - originY);
+			if ((dist <= limit) && spatial_object_matches(go, mask)) {
+				expected[expectedCount] = go;
+				expectedCount += 1;
+				if ((nearestDist < 0) || (dist < nearestDist)) { nearestDist = dist; }
+			}
+		}
+		u32 count = spatial_query_radius(originX, originY, radius, metric, mask, results, positionCount);
+		SPATIAL_CHECK(count == expectedCount);
+		for (u32 i = 0; i < expectedCount; i++) {
+			SPATIAL_CHECK(spatial_check_contains(results, count, expected[i]));
+		}
+
+		// Nearest, within the same radius
+		GameObject *nearest = spatial_query_nearest(originX, originY, radius, metric, 
+													spatial_check_has_components, &mask);
+		if (nearestDist < 0) {
+			SPATIAL_CHECK(nearest == NULL);
+		} else if (nearest == NULL) {
+			passed = false;
+		} else {
+			Position *p = (Position *)game_object_get_component(nearest, COMP_POSITION);
+			SPATIAL_CHECK(spatial_check_distance(metric, p->x - originX, p->y - originY) == nearestDist);
+			SPATIAL_CHECK(spatial_object_matches(nearest, mask));
+		}
+
+		// Rectangle, with the origin as its top left
+		seed = (seed * 1664525) + 1013904223;
+		UIRect rect = {originX, originY, (i32)((seed >> 8) % 40) - 2, (i32)((seed >> 16) % 30) - 2};
+		expectedCount = 0;
+		for (u32 i = 0; i < positionCount; i++) {
+			GameObject *go = game_object_get(positions[i].objectId);
+			if ((positions[i].x >= rect.x) && (positions[i].x < rect.x + rect.w) &&
+				(positions[i].y >= rect.y) && (positions[i].y < rect.y + rect.h) &&
+				spatial_object_matches(go, mask)) {
+				expected[expectedCount] = go;
+				expectedCount += 1;
+			}
+		}
+		count = spatial_query_rect(&rect, mask, results, positionCount);
+		SPATIAL_CHECK(count == expectedCount);
+		for (u32 i = 0; i < expectedCount; i++) {
+			SPATIAL_CHECK(spatial_check_contains(results, count, expected[i]));
+		}
+
+		// Batched, into a buffer too small for all of them every other time, 
+		// which must come out as the single queries would, cut short
+		origins[q % SPATIAL_CHECK_BATCH] = (Point){originX, originY};
+		if ((q % SPATIAL_CHECK_BATCH) == (SPATIAL_CHECK_BATCH - 1)) {
+			u32 wanted = 0;
+			for (u32 b = 0; b < SPATIAL_CHECK_BATCH; b++) {
+				wanted += spatial_query_radius(origins[b].x, origins[b].y, radius, metric, mask, results, 0);
+			}
+			u32 maxResults = (q & 8) ? wanted : (wanted / 2);
+			u32 total = spatial_query_radius_batch(origins, SPATIAL_CHECK_BATCH, radius, metric, mask,
+												   batchResults, maxResults, ranges);
+			SPATIAL_CHECK(total == wanted);
+
+			u32 written = 0;
+			for (u32 b = 0; b < SPATIAL_CHECK_BATCH; b++) {
+				count = spatial_query_radius(origins[b].x, origins[b].y, radius, metric, mask, 
+											 results, positionCount);
+				u32 room = maxResults - written;
+				SPATIAL_CHECK(ranges[b].first == written);
+				SPATIAL_CHECK(ranges[b].count == ((count < room) ? count : room));
+				SPATIAL_CHECK(memcmp(&batchResults[ranges[b].first], results, 
+							  ranges[b].count * sizeof(GameObject *)) == 0);
+				written += ranges[b].count;
+			}
+		}
+	}
+
+	free(results);
+	free(expected);
+	free(batchResults);
+	return passed;
+}
+
+#endif
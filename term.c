@@ -0,0 +1,489 @@
+/*
+* term.c - ANSI terminal backend
+*
+* Draws the active screen's console cells to a terminal instead of pixels
+* to a window: CP437 glyphs go out as UTF-8, colors as 24-bit escapes, and
+* only the cells that changed since the last frame are sent.
+*/
+
+#ifndef _WIN32
+#include <termios.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/select.h>
+#endif
+
+#define TERM_COLS	(SCREEN_WIDTH / 16)
+#define TERM_ROWS	(SCREEN_HEIGHT / 16)
+
+// A single character cell as it appears on the terminal
+typedef struct {
+	asciiChar glyph;
+	u32 fgColor;		// opaque RGBA
+	u32 bgColor;		// may be transparent until every view has been drawn
+} TermCell;
+
+typedef struct {
+	bool active;
+	TermCell cells[TERM_ROWS][TERM_COLS];	// what the screen should show
+	TermCell shown[TERM_ROWS][TERM_COLS];	// what the terminal currently shows
+	bool shownValid;
+
+	// Output is collected for the whole frame and written in one go
+	char *out;
+	u32 outLength;
+	u32 outCapacity;
+
+	// Where the terminal's cursor and colors are after the last write
+	i32 cursorX, cursorY;		// cursorX < 0 when unknown
+	u32 currentFg, currentBg;
+	bool colorsKnown;
+
+	// Output stats, in bytes - reported on exit
+	u64 bytesTotal;
+	u64 bytesThisTurn;
+	u64 bytesMaxTurn;
+	u32 turnCount;
+
+#ifndef _WIN32
+	struct termios savedTermios;
+#endif
+} Terminal;
+
+global_variable Terminal terminal = {0};
+
+// Unicode code point for each CP437 character
+global_variable u16 cp437ToUnicode[256] = {
+	0x0020, 0x263a, 0x263b, 0x2665, 0x2666, 0x2663, 0x2660, 0x2022,
+	0x25d8, 0x25cb, 0x25d9, 0x2642, 0x2640, 0x266a, 0x266b, 0x263c,
+	0x25ba, 0x25c4, 0x2195, 0x203c, 0x00b6, 0x00a7, 0x25ac, 0x21a8,
+	0x2191, 0x2193, 0x2192, 0x2190, 0x221f, 0x2194, 0x25b2, 0x25bc,
+	0x0020, 0x0021, 0x0022, 0x0023, 0x0024, 0x0025, 0x0026, 0x0027,
+	0x0028, 0x0029, 0x002a, 0x002b, 0x002c, 0x002d, 0x002e, 0x002f,
+	0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+	0x0038, 0x0039, 0x003a, 0x003b, 0x003c, 0x003d, 0x003e, 0x003f,
+	0x0040, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+	0x0048, 0x0049, 0x004a, 0x004b, 0x004c, 0x004d, 0x004e, 0x004f,
+	0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057,
+	0x0058, 0x0059, 0x005a, 0x005b, 0x005c, 0x005d, 0x005e, 0x005f,
+	0x0060, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+	0x0068, 0x0069, 0x006a, 0x006b, 0x006c, 0x006d, 0x006e, 0x006f,
+	0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,
+	0x0078, 0x0079, 0x007a, 0x007b, 0x007c, 0x007d, 0x007e, 0x2302,
+	0x00c7, 0x00fc, 0x00e9, 0x00e2, 0x00e4, 0x00e0, 0x00e5, 0x00e7,
+	0x00ea, 0x00eb, 0x00e8, 0x00ef, 0x00ee, 0x00ec, 0x00c4, 0x00c5,
+	0x00c9, 0x00e6, 0x00c6, 0x00f4, 0x00f6, 0x00f2, 0x00fb, 0x00f9,
+	0x00ff, 0x00d6, 0x00dc, 0x00a2, 0x00a3, 0x00a5, 0x20a7, 0x0192,
+	0x00e1, 0x00ed, 0x00f3, 0x00fa, 0x00f1, 0x00d1, 0x00aa, 0x00ba,
+	0x00bf, 0x2310, 0x00ac, 0x00bd, 0x00bc, 0x00a1, 0x00ab, 0x00bb,
+	0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556,
+	0x2555, 0x2563, 0x2551, 0x2557, 0x255d, 0x255c, 0x255b, 0x2510,
+	0x2514, 0x2534, 0x252c, 0x251c, 0x2500, 0x253c, 0x255e, 0x255f,
+	0x255a, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256c, 0x2567,
+	0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256b,
+	0x256a, 0x2518, 0x250c, 0x2588, 0x2584, 0x258c, 0x2590, 0x2580,
+	0x03b1, 0x00df, 0x0393, 0x03c0, 0x03a3, 0x03c3, 0x00b5, 0x03c4,
+	0x03a6, 0x0398, 0x03a9, 0x03b4, 0x221e, 0x03c6, 0x03b5, 0x2229,
+	0x2261, 0x00b1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00f7, 0x2248,
+	0x00b0, 0x2219, 0x00b7, 0x221a, 0x207f, 0x00b2, 0x25a0, 0x00a0,
+};
+
+
+/* Output Helpers */
+
+internal void
+term_write(char *data, u32 length)
+{
+	if (terminal.outLength + length > terminal.outCapacity) {
+		terminal.outCapacity = (terminal.outLength + length) * 2;
+		terminal.out = realloc(terminal.out, terminal.outCapacity);
+	}
+	memcpy(&terminal.out[terminal.outLength], data, length);
+	terminal.outLength += length;
+}
+
+internal void
+term_write_string(char *str)
+{
+	term_write(str, strlen(str));
+}
+
+internal void
+term_write_glyph(asciiChar glyph)
+{
+	// Encode the glyph's code point as UTF-8
+	u16 cp = cp437ToUnicode[glyph];
+	char utf8[3];
+	if (cp < 0x80) {
+		utf8[0] = (char)cp;
+		term_write(utf8, 1);
+	} else if (cp < 0x800) {
+		utf8[0] = (char)(0xc0 | (cp >> 6));
+		utf8[1] = (char)(0x80 | (cp & 0x3f));
+		term_write(utf8, 2);
+	} else {
+		utf8[0] = (char)(0xe0 | (cp >> 12));
+		utf8[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+		utf8[2] = (char)(0x80 | (cp & 0x3f));
+		term_write(utf8, 3);
+	}
+}
+
+internal void
+term_flush()
+{
+	if (terminal.outLength == 0) { return; }
+
+	fwrite(terminal.out, 1, terminal.outLength, stdout);
+	fflush(stdout);
+	terminal.bytesTotal += terminal.outLength;
+	terminal.bytesThisTurn += terminal.outLength;
+	terminal.outLength = 0;
+}
+
+internal void
+term_move_cursor(i32 x, i32 y)
+{
+	// Pick the shortest way of getting the cursor to (x, y)
+	if ((terminal.cursorX == x) && (terminal.cursorY == y)) { return; }
+
+	char seq[32];
+	if ((terminal.cursorX >= 0) && (terminal.cursorY == y) && (x > terminal.cursorX)) {
+		i32 gap = x - terminal.cursorX;
+		if (gap == 1) {
+			snprintf(seq, sizeof(seq), "\x1b[C");
+		} else {
+			snprintf(seq, sizeof(seq), "\x1b[%dC", gap);
+		}
+	} else if ((terminal.cursorX >= 0) && (x == 0) && (y == terminal.cursorY + 1)) {
+		snprintf(seq, sizeof(seq), "\r\n");
+	} else if (x == 0) {
+		snprintf(seq, sizeof(seq), "\x1b[%dH", y + 1);
+	} else {
+		snprintf(seq, sizeof(seq), "\x1b[%d;%dH", y + 1, x + 1);
+	}
+	term_write_string(seq);
+
+	terminal.cursorX = x;
+	terminal.cursorY = y;
+}
+
+internal void
+term_set_colors(u32 fgColor, u32 bgColor)
+{
+	// Only send the colors that differ from the ones already in effect
+	bool fgChanged = !terminal.colorsKnown || (fgColor != terminal.currentFg);
+	bool bgChanged = !terminal.colorsKnown || (bgColor != terminal.currentBg);
+	if (!fgChanged && !bgChanged) { return; }
+
+	char seq[48];
+	if (fgChanged && bgChanged) {
+		snprintf(seq, sizeof(seq), "\x1b[38;2;%u;%u;%u;48;2;%u;%u;%um", 
+				 RED(fgColor), GREEN(fgColor), BLUE(fgColor),
+				 RED(bgColor), GREEN(bgColor), BLUE(bgColor));
+	} else if (fgChanged) {
+		snprintf(seq, sizeof(seq), "\x1b[38;2;%u;%u;%um", 
+				 RED(fgColor), GREEN(fgColor), BLUE(fgColor));
+	} else {
+		snprintf(seq, sizeof(seq), "\x1b[48;2;%u;%u;%um", 
+				 RED(bgColor), GREEN(bgColor), BLUE(bgColor));
+	}
+	term_write_string(seq);
+
+	terminal.currentFg = fgColor;
+	terminal.currentBg = bgColor;
+	terminal.colorsKnown = true;
+}
+
+internal bool
+term_cells_equal(TermCell *a, TermCell *b)
+{
+	return (a->glyph == b->glyph) && (a->bgColor == b->bgColor) &&
+		   ((a->glyph == ' ') || (a->fgColor == b->fgColor));
+}
+
+
+/* Input */
+
+#ifndef _WIN32
+
+internal void
+term_push_key(SDL_Keycode key)
+{
+	SDL_Event event = {0};
+	event.type = SDL_KEYDOWN;
+	event.key.state = SDL_PRESSED;
+	event.key.keysym.sym = key;
+	SDL_PushEvent(&event);
+}
+
+internal void
+term_poll_input()
+{
+	// Turn whatever has been typed into key down events for the screens
+	char buffer[64];
+	i32 count = read(STDIN_FILENO, buffer, sizeof(buffer));
+	for (i32 i = 0; i < count; i++) {
+		char c = buffer[i];
+		if (c == 0x1b) {
+			// Arrow keys come in as ESC [ A..D - a lone ESC is the escape key
+			if ((i + 2 < count) && ((buffer[i + 1] == '[') || (buffer[i + 1] == 'O'))) {
+				SDL_Keycode key = SDLK_UNKNOWN;
+				switch (buffer[i + 2]) {
+					case 'A': key = SDLK_UP; break;
+					case 'B': key = SDLK_DOWN; break;
+					case 'C': key = SDLK_RIGHT; break;
+					case 'D': key = SDLK_LEFT; break;
+					default: break;
+				}
+				if (key != SDLK_UNKNOWN) { term_push_key(key); }
+				i += 2;
+			} else {
+				term_push_key(SDLK_ESCAPE);
+			}
+		} else if ((c == '\r') || (c == '\n')) {
+			term_push_key(SDLK_RETURN);
+		} else if (c == 0x03) {
+			// Ctrl-C
+			SDL_Event event = {0};
+			event.type = SDL_QUIT;
+			SDL_PushEvent(&event);
+		} else if ((c >= 'A') && (c <= 'Z')) {
+			term_push_key(c - 'A' + 'a');
+		} else if ((c >= ' ') && (c < 0x7f)) {
+			term_push_key(c);
+		}
+	}
+}
+
+/*
+Blocks until something is typed or timeoutMs has passed (-1 waits forever),
+then turns any input into events.
+*/
+internal void
+term_wait_for_input(i32 timeoutMs)
+{
+	fd_set readSet;
+	FD_ZERO(&readSet);
+	FD_SET(STDIN_FILENO, &readSet);
+
+	struct timeval timeout;
+	timeout.tv_sec = timeoutMs / 1000;
+	timeout.tv_usec = (timeoutMs % 1000) * 1000;
+	select(STDIN_FILENO + 1, &readSet, NULL, NULL, (timeoutMs < 0) ? NULL : &timeout);
+
+	term_poll_input();
+}
+
+#else
+
+internal void
+term_poll_input() {}
+
+internal void
+term_wait_for_input(i32 timeoutMs) { SDL_Delay((timeoutMs < 0) ? 0 : timeoutMs); }
+
+#endif
+
+
+/* Backend Functions */
+
+internal void
+term_shutdown()
+{
+	if (!terminal.active) { return; }
+
+	// Put the terminal back the way we found it
+	term_write_string("\x1b[0m\x1b[?25h\x1b[?1049l");
+	term_flush();
+#ifndef _WIN32
+	tcsetattr(STDIN_FILENO, TCSANOW, &terminal.savedTermios);
+#endif
+	terminal.active = false;
+
+	// One line of output stats, now the normal screen is back so it stays 
+	// visible. Bytes for the turn in progress count as one more turn.
+	if (terminal.bytesThisTurn > 0) {
+		terminal.turnCount += 1;
+		if (terminal.bytesThisTurn > terminal.bytesMaxTurn) { terminal.bytesMaxTurn = terminal.bytesThisTurn; }
+	}
+	u64 average = (terminal.turnCount > 0) ? (terminal.bytesTotal / terminal.turnCount) : 0;
+	fprintf(stderr, "Terminal output: %llu bytes over %u turns (%llu bytes/turn average, %llu max)\n",
+			(unsigned long long)terminal.bytesTotal, terminal.turnCount,
+			(unsigned long long)average, (unsigned long long)terminal.bytesMaxTurn);
+}
+
+internal bool
+term_init()
+{
+#ifdef _WIN32
+	printf("The terminal backend is not supported on Windows\n");
+	return false;
+#else
+	// Raw, non-blocking input so single key presses come straight through
+	if (tcgetattr(STDIN_FILENO, &terminal.savedTermios) != 0) {
+		printf("The terminal backend needs a terminal on stdin\n");
+		return false;
+	}
+	struct termios raw = terminal.savedTermios;
+	raw.c_lflag &= ~(ICANON | ECHO | ISIG);
+	raw.c_iflag &= ~(IXON | ICRNL);
+	raw.c_cc[VMIN] = 0;
+	raw.c_cc[VTIME] = 0;
+	tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+
+	terminal.active = true;
+	atexit(term_shutdown);
+	terminal.shownValid = false;
+	terminal.cursorX = -1;
+	terminal.colorsKnown = false;
+
+	// Switch to the alternate screen and hide the cursor
+	term_write_string("\x1b[?1049h\x1b[?25l\x1b[2J");
+	term_flush();
+	terminal.bytesTotal = 0;
+	terminal.bytesThisTurn = 0;
+
+	return true;
+#endif
+}
+
+internal void
+term_end_turn()
+{
+	// Close off the byte count for the turn that just finished
+	terminal.turnCount += 1;
+	if (terminal.bytesThisTurn > terminal.bytesMaxTurn) { 
+		terminal.bytesMaxTurn = terminal.bytesThisTurn; 
+	}
+	terminal.bytesThisTurn = 0;
+}
+
+internal void
+term_draw_view(UIView *view)
+{
+	// Flatten each cell's stack of glyphs into a single terminal cell and 
+	// lay it over whatever the views beneath left there
+	Console *con = view->console;
+	i32 originX = view->pixelRect->x / 16;
+	i32 originY = view->pixelRect->y / 16;
+
+	for (u32 cellY = 0; cellY < con->rowCount; cellY++) {
+		i32 y = originY + cellY;
+		if ((y < 0) || (y >= TERM_ROWS)) { continue; }
+
+		for (u32 cellX = 0; cellX < con->colCount; cellX++) {
+			i32 x = originX + cellX;
+			if ((x < 0) || (x >= TERM_COLS)) { continue; }
+
+			ConsoleCellStack *stack = &con->cells[cellY * con->colCount + cellX];
+			TermCell *dest = &terminal.cells[y][x];
+
+			// Background starts as the console color, or the bitmap backdrop 
+			// sampled in the middle of the cell
+			u32 bgColor = con->bgColor;
+			if (stack->image != NULL) {
+				BitmapImage *img = stack->image;
+				u32 sampleX = stack->imageX + (con->cellWidth / 2);
+				u32 sampleY = stack->imageY + (con->cellHeight / 2);
+				if ((sampleX < img->width) && (sampleY < img->height)) {
+					bgColor = img->pixels[(sampleY * img->width) + sampleX];
+				}
+			}
+
+			asciiChar glyph = ' ';
+			u32 fgColor = 0;
+			for (u32 i = 0; i < stack->layerCount; i++) {
+				ConsoleCell *layer = &stack->layers[i];
+				bgColor = ui_blend_pixel(bgColor, layer->bgColor);
+				if ((layer->glyph != ' ') && (layer->glyph != 0)) {
+					glyph = layer->glyph;
+					fgColor = layer->fgColor;
+				}
+			}
+
+			// Whatever is underneath shows through a see-through background
+			u32 under = dest->bgColor;
+			if (ALPHA(bgColor) < 255) {
+				if (glyph == ' ') {
+					glyph = dest->glyph;
+					fgColor = ui_blend_pixel(dest->fgColor, bgColor);
+				}
+				bgColor = ui_blend_pixel(under, bgColor);
+			}
+			if (glyph != ' ') {
+				// Faded glyphs are drawn as their color mixed into the background
+				fgColor = ui_blend_pixel(bgColor | 0xff, fgColor) | 0xff;
+			}
+
+			dest->glyph = glyph;
+			dest->fgColor = fgColor;
+			dest->bgColor = bgColor;
+		}
+	}
+}
+
+internal void
+term_present(UIScreen *screen)
+{
+	// Build up what the screen should look like, view by view, back to front
+	TermCell blank = {' ', 0xffffffff, 0x000000ff};
+	for (u32 y = 0; y < TERM_ROWS; y++) {
+		for (u32 x = 0; x < TERM_COLS; x++) {
+			terminal.cells[y][x] = blank;
+		}
+	}
+	for (ListElement *e = list_head(screen->views); e != NULL; e = list_next(e)) {
+		UIView *v = (UIView *)list_data(e);
+		if (!v->hidden) {
+			term_draw_view(v);
+		}
+	}
+
+	// Send only the cells that differ from what the terminal already shows. 
+	// Short runs of unchanged cells between changes are cheaper to re-send 
+	// than to jump over, as long as they don't need a color change.
+	for (i32 y = 0; y < TERM_ROWS; y++) {
+		i32 x = 0;
+		while (x < TERM_COLS) {
+			TermCell *cell = &terminal.cells[y][x];
+			if (terminal.shownValid && term_cells_equal(cell, &terminal.shown[y][x])) {
+				x += 1;
+				continue;
+			}
+
+			// Fill a small gap after the last cell written on this row
+			if ((terminal.cursorY == y) && (terminal.cursorX >= 0) && (terminal.cursorX < x) && 
+				(x - terminal.cursorX <= 3)) {
+				bool cheapFill = true;
+				for (i32 gx = terminal.cursorX; gx < x; gx++) {
+					TermCell *gap = &terminal.cells[y][gx];
+					if ((gap->bgColor != terminal.currentBg) || 
+						((gap->glyph != ' ') && (gap->fgColor != terminal.currentFg)) ||
+						(cp437ToUnicode[gap->glyph] >= 0x80)) {
+						cheapFill = false;
+						break;
+					}
+				}
+				if (cheapFill) {
+					for (i32 gx = terminal.cursorX; gx < x; gx++) {
+						term_write_glyph(terminal.cells[y][gx].glyph);
+					}
+					terminal.cursorX = x;
+				}
+			}
+
+			term_move_cursor(x, y);
+			term_set_colors((cell->glyph == ' ') ? terminal.currentFg : cell->fgColor, cell->bgColor);
+			term_write_glyph(cell->glyph);
+			terminal.shown[y][x] = *cell;
+
+			// The cursor doesn't move on past the last column
+			x += 1;
+			terminal.cursorX = (x < TERM_COLS) ? x : -1;
+		}
+	}
+	terminal.shownValid = true;
+
+	term_flush();
+}
@@ -11,6 +11,20 @@
 #define STBI_ONLY_PNG
 #include "stb_image.h"
 
+// SIMD intrinsics for the blend kernels - x86 only, picked at runtime
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define UI_BLEND_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define UI_TARGET_SSE2
+#define UI_TARGET_AVX2
+#else
+#define UI_TARGET_SSE2 __attribute__((target("sse2")))
+#define UI_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
 
 // Helper macros for working with pixel colors
 #define RED(c) ((c & 0xff000000) >> 24)
@@ -34,21 +48,113 @@ typedef struct {
     u32 bgColor;
 } ConsoleCell;
 
+// Glyphs and image cells are matched by shape, one bit per pixel, so only
+// fonts with up to 256 pixels per glyph (e.g. 16x16) can be used to asciify.
+#define GLYPH_SHAPE_BITS    256
+#define GLYPH_SHAPE_WORDS   (GLYPH_SHAPE_BITS / 64)
+
 typedef struct {
-    u32 *atlas;
+    u64 bits[GLYPH_SHAPE_WORDS];
+} GlyphShape;
+
+typedef struct {
+    bool colorize;      // drawn in each cell's color, rather than as it is
+    u32 *atlas;         // RGBA pixels, for fonts drawn as they are
+    u8 *coverage;       // one byte per pixel, for colorized fonts
+    bool ownsAtlas;     // false when the atlas lives in the asset pack
     u32 atlasWidth;
     u32 atlasHeight;
     u32 charWidth;
     u32 charHeight;
     asciiChar firstCharInAtlas;
 
-    // TODO: Consider chopping the atlas into BitmapImages for each cell
-    // TODO: This will optimize the ASCIIfy routine, and may even help with rendering?
+    char *filename;     // fonts are shared through the registry, keyed by file, 
+    u32 refCount;       // char size and colorize, and are read-only once loaded
+
+    GlyphShape *glyphShapes;    // built the first time the font is used to 
+    u32 glyphCount;             // asciify an image
 
 } ConsoleFont;
 
+/* Image Types */
+typedef struct {
+    u32 *pixels;
+    u32 width;
+    u32 height;    
+    char *filename;     // file the image was loaded from, if any
+} BitmapImage;
+
+typedef struct {
+    ConsoleCell *cells;
+    u32 rows;
+    u32 cols;
+} AsciiImage;
+
+
+/* Console Types */
+
+// Max number of glyphs that can be stacked in a single cell in one frame. 
+// If a cell overflows, its bottom-most glyph is dropped.
+#define CONSOLE_CELL_LAYERS     6
+
+// layerCount value marking a rasterized cell as stale, forcing a redraw
+#define CONSOLE_CELL_INVALID    0xff
+
+// Everything drawn into a single console cell during a frame, from the 
+// bottom up: an optional bitmap backdrop, then each glyph in draw order.
+typedef struct {
+    BitmapImage *image;
+    u32 imageX, imageY;     // pixel offset of this cell within the image
+    u8 layerCount;
+    ConsoleCell layers[CONSOLE_CELL_LAYERS];
+} ConsoleCellStack;
+
+/* Glyph Tile Cache Types */
+
+// Number of pre-rendered glyph tiles kept per cache
+#define TILE_CACHE_CAPACITY     512
+#define TILE_CACHE_BUCKETS      1024    // must be a power of two
+#define TILE_NONE               -1
+
+// A glyph fully colorized and composited over a solid background, ready 
+// to be copied straight into a console.
+typedef struct {
+    ConsoleFont *font;
+    asciiChar glyph;
+    u32 fgColor;
+    u32 bgColor;
+    bool colorize;
+    i32 hashNext;           // next tile in the same hash bucket
+    i32 lruPrev, lruNext;   // neighbours in least-recently-used order
+    u32 *pixels;
+} CachedTile;
+
+typedef struct {
+    u32 tileWidth;
+    u32 tileHeight;
+    u32 count;
+    CachedTile tiles[TILE_CACHE_CAPACITY];
+    i32 buckets[TILE_CACHE_BUCKETS];
+    i32 lruHead;            // most recently used
+    i32 lruTail;            // least recently used - first to be evicted
+    u32 *pixels;
+    u32 hits;
+    u32 misses;
+} TileCache;
+
+// The tile caches for one cell size, shared by every console with that size. 
+// Row bands are rasterized at the same time, so each band has a cache of its 
+// own, but there are never more bands than worker threads.
+typedef struct {
+    u32 tileWidth;
+    u32 tileHeight;
+    TileCache *caches[WORKER_THREADS_MAX];  // created as bands first need them
+} TileCacheSet;
+
 typedef struct {
     u32 *pixels;      // in-memory representation of the screen pixels
+    u32 pitch;        // pixels per row of the buffer that pixels points into
+    bool ownsPixels;  // false when drawing straight into the framebuffer
     u32 width;
     u32 height;
     u32 rowCount;
@@ -58,22 +164,35 @@ typedef struct {
     u32 bgColor;
     bool colorize;
     ConsoleFont *font;
-    ConsoleCell *cells;
+    ConsoleCellStack *cells;        // logical model of what the console should show
+    ConsoleCellStack *drawnCells;   // what is currently rasterized into pixels
+    TileCacheSet *tileCaches;       // shared with every console of the same cell size
 } Console;
 
+typedef struct {
+    Console *con;
+    u32 bandCount;
+    UIRect changed[WORKER_THREADS_MAX];     // cells redrawn by each band
+    u32 cellCount[WORKER_THREADS_MAX];
+} ConsoleRasterJob;
 
-/* Image Types */
+// Running totals of the work done by console_rasterize, for benchmarking
 typedef struct {
-    u32 *pixels;
-    u32 width;
-    u32 height;    
-} BitmapImage;
+    u64 cellCount;      // cells re-rasterized
+    u64 pixelCount;     // pixels those cells covered
+} UIRasterStats;
+
+
+/* Framebuffer Types */
 
+// The whole screen as it should be presented. Views rasterize straight into 
+// their part of it, and only the damaged area gets copied to the texture.
 typedef struct {
-    ConsoleCell *cells;
-    u32 rows;
-    u32 cols;
-} AsciiImage;
+    u32 *pixels;
+    u32 width;
+    u32 height;
+    UIRect damage;      // changed since the last present - empty when w == 0
+} UIFramebuffer;
 
 
 /* UI Types */
@@ -87,6 +206,9 @@ typedef struct {
     Console *console;
     UIRect *pixelRect;
     UIRenderFunction render;
+    bool onDemand;      // only re-render when marked dirty, rather than every frame
+    bool dirty;
+    bool hidden;        // stays in its screen, but is skipped when rendering
 } UIView;
 
 struct UIScreen {
@@ -99,6 +221,12 @@ struct UIScreen {
 /* UI State */
 global_variable UIScreen *activeScreen = NULL;
 global_variable bool asciiMode = true;
+global_variable List *fontRegistry = NULL;
+global_variable SDL_mutex *fontRegistryLock = NULL;    // fonts are also loaded in the background
+global_variable List *tileCacheSets = NULL;
+global_variable UIFramebuffer framebuffer = {0};
+global_variable bool redrawRequested = true;     // something on screen needs updating
+global_variable UIRasterStats rasterStats = {0};
 
 
 /* 
@@ -115,9 +243,36 @@ ui_get_active_screen();
 internal void 
 ui_set_active_screen(UIScreen *screen);
 
+internal void
+ui_request_redraw();
 
-internal void 
-view_destroy(UIView *view);
+internal void
+ui_framebuffer_init(u32 width, u32 height);
+
+internal void
+ui_damage(UIRect *rect);
+
+internal void
+ui_composite_view(UIView *view);
+
+internal void
+ui_framebuffer_present(SDL_Texture *texture);
+
+internal void
+ui_framebuffer_clear_damage();
+
+internal bool
+ui_framebuffer_write_ppm(char *filename);
+
+internal bool
+ui_framebuffer_write_png(char *filename);
+
+
+internal void
+view_mark_dirty(UIView *view);
+
+internal void
+view_set_hidden(UIView *view, bool hidden);
 
 internal UIView * 
 view_new(UIRect pixelRect, u32 cellCountX, u32 cellCountY, 
@@ -143,14 +298,43 @@ console_clear(Console *con);
 internal void
 console_destroy(Console *con);
 
+internal void
+console_invalidate(Console *con);
+
+internal void
+console_invalidate_rect(Console *con, UIRect *pixelRect);
+
+internal void
+console_invalidate_rect(Console *con, UIRect *pixelRect) {
+    // Force the cells touching the given pixel rect to be re-rasterized
+    if ((pixelRect->w <= 0) || (pixelRect->h <= 0)) { return; }
+    u32 startX = pixelRect->x / con->cellWidth;
+    u32 startY = pixelRect->y / con->cellHeight;
+    u32 stopX = (pixelRect->x + pixelRect->w + con->cellWidth - 1) / con->cellWidth;
+    u32 stopY = (pixelRect->y + pixelRect->h + con->cellHeight - 1) / con->cellHeight;
+    if (stopX > con->colCount) { stopX = con->colCount; }
+    if (stopY > con->rowCount) { stopY = con->rowCount; }
+
+    for (u32 y = startY; y < stopY; y++) {
+        for (u32 x = startX; x < stopX; x++) {
+            con->drawnCells[y * con->colCount + x].layerCount = CONSOLE_CELL_INVALID;
+        }
+    }
+}
+
 internal Console *
-console_new(i32 width, i32 height, i32 rowCount, i32 colCount, u32 bgColor, bool colorize);
+console_new(i32 width, i32 height, i32 rowCount, i32 colCount, u32 bgColor, bool colorize,
+            u32 *pixels, u32 pitch);
 
 internal void 
 console_put_char_at(Console *con, asciiChar c, 
                     i32 cellX, i32 cellY,
                     u32 fgColor, u32 bgColor);
 
+internal void
+console_put_image_cell_at(Console *con, BitmapImage *image, 
+                          u32 imageX, u32 imageY, i32 cellX, i32 cellY);
+
 internal void 
 console_put_string_at(Console *con, char *string, 
                       i32 x, i32 y,
@@ -161,12 +345,47 @@ console_put_string_in_rect(Console *con, char *string,
                            UIRect rect, bool wrap, 
                            u32 fgColor, u32 bgColor);
 
+internal UIRect
+console_rasterize(Console *con);
+
 internal void 
 console_set_bitmap_font(Console *con, char *filename, 
                         asciiChar firstCharInAtlas,
                         i32 charWidth, i32 charHeight);
 
 
+/* Font Functions */
+
+internal void
+font_registry_init();
+
+internal ConsoleFont *
+font_acquire(char *filename, asciiChar firstCharInAtlas,
+             u32 charWidth, u32 charHeight, bool colorize);
+
+internal void
+font_release(ConsoleFont *font);
+
+
+/* Tile Cache Functions */
+
+internal TileCache *
+tile_cache_new(u32 tileWidth, u32 tileHeight);
+
+internal void
+tile_cache_clear(TileCache *cache);
+
+internal TileCacheSet *
+tile_cache_set_acquire(u32 tileWidth, u32 tileHeight);
+
+internal void
+tile_cache_sets_clear();
+
+internal u32 *
+tile_cache_get(TileCache *cache, ConsoleFont *font, asciiChar glyph, u32 fgColor, 
+               u32 bgColor, bool colorize, bool *found);
+
+
 /* Image Functions */
 
 internal AsciiImage*
@@ -175,17 +394,45 @@ asciify_bitmap(Console *con, BitmapImage *image);
 internal BitmapImage*
 image_load_from_file(char *filename);
 
-internal BitmapImage *
-image_slice(BitmapImage *img, i32 rows, i32 cols);
-
 internal void 
-image_analyze_colors(BitmapImage *image, u32 *primaryColor, u32 *secondaryColor);
+image_analyze_colors(BitmapImage *image, UIRect *cellRect, 
+                     u32 *primaryColor, u32 *secondaryColor);
+
+internal void
+image_mask_create(BitmapImage *image, UIRect *cellRect, 
+                  u32 primaryColor, u32 secondaryColor, GlyphShape *mask);
 
-internal BitmapImage *
-image_mask_create(BitmapImage *origImage, u32 primaryColor, u32 secondaryColor);
+internal void
+font_build_glyph_shapes(ConsoleFont *font);
 
 internal asciiChar
-image_match_glyph(Console *console, BitmapImage *maskImage);
+image_match_glyph(ConsoleFont *font, GlyphShape *mask);
+
+
+/* Blend Kernels */
+
+// Number of pixels blended per call into a kernel
+#define BLEND_SPAN_MAX  64
+
+// Blends count source pixels over count destination pixels (src-over)
+typedef void (*UIBlendSpanFn)(u32 *dest, u32 *src, u32 count);
+
+internal void
+ui_blend_span_scalar(u32 *dest, u32 *src, u32 count);
+
+global_variable UIBlendSpanFn ui_blend_span = ui_blend_span_scalar;
+
+// Blends a single color over count destination pixels, scaled by the 
+// 8-bit coverage of each (as colorizing a glyph does)
+typedef void (*UIBlendCoverageFn)(u32 *dest, u8 *coverage, u32 color, u32 count);
+
+internal void
+ui_blend_coverage_scalar(u32 *dest, u8 *coverage, u32 color, u32 count);
+
+global_variable UIBlendCoverageFn ui_blend_coverage = ui_blend_coverage_scalar;
+
+internal void
+ui_blend_init();
 
 
 /* Utility Functions */
@@ -196,7 +443,16 @@ ui_colorize_pixel(u32 dest, u32 src);
 internal void
 ui_copy_blend(u32 *destPixels, UIRect *destRect, u32 destPixelsPerRow,
            u32 *srcPixels, UIRect *srcRect, u32 srcPixelsPerRow,
-           bool colorize, u32 *newColor);
+           u32 *newColor);
+
+internal void
+ui_copy_blend_coverage(u32 *destPixels, UIRect *destRect, u32 destPixelsPerRow,
+                    u8 *coverage, UIRect *srcRect, u32 coveragePerRow,
+                    u32 color);
+
+internal void
+font_blend_glyph(ConsoleFont *font, asciiChar glyph, u32 fgColor,
+                 u32 *destPixels, UIRect *destRect, u32 destPixelsPerRow);
 
 internal void
 ui_fill(u32 *pixels, u32 pixelsPerRow, UIRect *destRect, u32 color);
@@ -221,26 +477,284 @@ ui_get_active_screen() {
 
 internal void 
 ui_set_active_screen(UIScreen *screen) {
-    if (activeScreen != NULL) { free(activeScreen); }
+    // Screens are built once and stay resident, so switching is just a 
+    // matter of pointing at the new one. Its views may have gone stale 
+    // while it was inactive, so have them all redraw.
+    if (screen == activeScreen) { return; }
+
     activeScreen = screen;
+    UIRect fullRect = {0, 0, framebuffer.width, framebuffer.height};
+    ui_damage(&fullRect);
+    if (screen != NULL) {
+        for (ListElement *e = list_head(screen->views); e != NULL; e = list_next(e)) {
+            view_mark_dirty((UIView *)list_data(e));
+        }
+    }
+}
+
+internal void
+ui_request_redraw() {
+    redrawRequested = true;
+}
+
+internal void
+ui_framebuffer_init(u32 width, u32 height) {
+    framebuffer.pixels = calloc(width * height, sizeof(u32));
+    framebuffer.width = width;
+    framebuffer.height = height;
+    UIRect fullRect = {0, 0, width, height};
+    framebuffer.damage = fullRect;
+}
+
+internal void
+ui_damage(UIRect *rect) {
+    // Grow the damaged area to cover rect
+    if ((rect->w <= 0) || (rect->h <= 0)) { return; }
+    ui_request_redraw();
+    if (framebuffer.damage.w <= 0) {
+        framebuffer.damage = *rect;
+    } else {
+        SDL_UnionRect(&framebuffer.damage, rect, &framebuffer.damage);
+    }
+}
+
+internal void
+ui_composite_view(UIView *view) {
+    // Anything already damaged this frame under the view was drawn over by 
+    // a view beneath it, so the view has to redraw those cells
+    Console *con = view->console;
+    UIRect overlap;
+    if ((framebuffer.damage.w > 0) && 
+        SDL_IntersectRect(&framebuffer.damage, view->pixelRect, &overlap)) {
+        overlap.x -= view->pixelRect->x;
+        overlap.y -= view->pixelRect->y;
+        console_invalidate_rect(con, &overlap);
+    }
+
+    PERF_BEGIN(PERF_BLEND);
+    UIRect changed = console_rasterize(con);
+    PERF_END(PERF_BLEND);
+    if (con->ownsPixels) {
+        // Not drawing into the framebuffer - copy whatever changed across
+        for (i32 y = changed.y; y < changed.y + changed.h; y++) {
+            memcpy(&framebuffer.pixels[((view->pixelRect->y + y) * framebuffer.width) + view->pixelRect->x + changed.x],
+                   &con->pixels[(y * con->pitch) + changed.x], changed.w * sizeof(u32));
+        }
+    }
+    changed.x += view->pixelRect->x;
+    changed.y += view->pixelRect->y;
+    ui_damage(&changed);
+}
+
+internal void
+ui_framebuffer_present(SDL_Texture *texture) {
+    // Upload just the damaged part of the framebuffer
+    UIRect damage = framebuffer.damage;
+    if (damage.w <= 0) { return; }
+
+    void *texturePixels;
+    i32 texturePitch;
+    if (SDL_LockTexture(texture, &damage, &texturePixels, &texturePitch) == 0) {
+        for (i32 y = 0; y < damage.h; y++) {
+            memcpy((u8 *)texturePixels + (y * texturePitch), 
+                   &framebuffer.pixels[((damage.y + y) * framebuffer.width) + damage.x],
+                   damage.w * sizeof(u32));
+        }
+        SDL_UnlockTexture(texture);
+    }
+
+    ui_framebuffer_clear_damage();
+}
+
+internal void
+ui_framebuffer_clear_damage() {
+    // Everything damaged so far has been dealt with
+    UIRect empty = {0, 0, 0, 0};
+    framebuffer.damage = empty;
+}
+
+internal void
+ui_framebuffer_get_rgb(u8 *rgb) {
+    // Flatten the framebuffer to packed RGB, as it looks on screen - 
+    // partly transparent pixels are shown over black
+    u32 pixelCount = framebuffer.width * framebuffer.height;
+    for (u32 i = 0; i < pixelCount; i++) {
+        u32 c = framebuffer.pixels[i];
+        u32 a = ALPHA(c);
+        rgb[i * 3 + 0] = (RED(c) * a + 127) / 255;
+        rgb[i * 3 + 1] = (GREEN(c) * a + 127) / 255;
+        rgb[i * 3 + 2] = (BLUE(c) * a + 127) / 255;
+    }
+}
+
+internal bool
+ui_framebuffer_write_ppm(char *filename) {
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) { return false; }
+
+    u32 rgbSize = framebuffer.width * framebuffer.height * 3;
+    u8 *rgb = malloc(rgbSize);
+    ui_framebuffer_get_rgb(rgb);
+
+    fprintf(file, "P6\n%u %u\n255\n", framebuffer.width, framebuffer.height);
+    bool ok = (fwrite(rgb, 1, rgbSize, file) == rgbSize);
+
+    free(rgb);
+    fclose(file);
+    return ok;
+}
+
+internal u32
+png_crc(u32 crc, u8 *data, u32 length) {
+    local_persist u32 crcTable[256];
+    local_persist bool tableReady = false;
+    if (!tableReady) {
+        for (u32 n = 0; n < 256; n++) {
+            u32 c = n;
+            for (u32 k = 0; k < 8; k++) {
+                c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+            }
+            crcTable[n] = c;
+        }
+        tableReady = true;
+    }
+
+    crc = ~crc;
+    for (u32 i = 0; i < length; i++) {
+        crc = crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+internal void
+png_put_u32(u8 *dest, u32 value) {
+    dest[0] = value >> 24;
+    dest[1] = (value >> 16) & 0xff;
+    dest[2] = (value >> 8) & 0xff;
+    dest[3] = value & 0xff;
+}
+
+internal void
+png_write_chunk(FILE *file, char *type, u8 *data, u32 length) {
+    u8 header[8];
+    png_put_u32(header, length);
+    memcpy(&header[4], type, 4);
+    u32 crc = png_crc(0, &header[4], 4);
+    crc = png_crc(crc, data, length);
+
+    u8 footer[4];
+    png_put_u32(footer, crc);
+    fwrite(header, 1, 8, file);
+    fwrite(data, 1, length, file);
+    fwrite(footer, 1, 4, file);
+}
+
+internal bool
+ui_framebuffer_write_png(char *filename) {
+    // Writes an RGB PNG with uncompressed (stored) deflate blocks - bigger 
+    // files, but no need for a compression library
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) { return false; }
+
+    u32 width = framebuffer.width;
+    u32 height = framebuffer.height;
+    u8 *rgb = malloc(width * height * 3);
+    ui_framebuffer_get_rgb(rgb);
+
+    // Raw image data is each scanline prefixed with filter type 0 (none)
+    u32 rowSize = (width * 3) + 1;
+    u32 rawSize = rowSize * height;
+    u8 *raw = malloc(rawSize);
+    for (u32 y = 0; y < height; y++) {
+        raw[y * rowSize] = 0;
+        memcpy(&raw[(y * rowSize) + 1], &rgb[y * width * 3], width * 3);
+    }
+
+    // Wrap it in a zlib stream of stored blocks, at most 65535 bytes each
+    u32 blockCount = (rawSize + 65534) / 65535;
+    u32 zlibSize = 2 + (blockCount * 5) + rawSize + 4;
+    u8 *zlib = malloc(zlibSize);
+    u8 *out = zlib;
+    *out++ = 0x78;
+    *out++ = 0x01;
+    u32 adlerA = 1, adlerB = 0;
+    for (u32 offset = 0; offset < rawSize; offset += 65535) {
+        u32 length = rawSize - offset;
+        if (length > 65535) { length = 65535; }
+        *out++ = ((offset + length) == rawSize) ? 1 : 0;
+        *out++ = length & 0xff;
+        *out++ = length >> 8;
+        *out++ = ~length & 0xff;
+        *out++ = (~length >> 8) & 0xff;
+        memcpy(out, &raw[offset], length);
+        out += length;
+
+        for (u32 i = 0; i < length; i++) {
+            adlerA = (adlerA + raw[offset + i]) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+    }
+    png_put_u32(out, (adlerB << 16) | adlerA);
+
+    u8 signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    fwrite(signature, 1, 8, file);
+
+    u8 ihdr[13];
+    png_put_u32(&ihdr[0], width);
+    png_put_u32(&ihdr[4], height);
+    ihdr[8] = 8;        // bit depth
+    ihdr[9] = 2;        // color type - RGB
+    ihdr[10] = 0;       // compression
+    ihdr[11] = 0;       // filter
+    ihdr[12] = 0;       // interlace
+    png_write_chunk(file, "IHDR", ihdr, 13);
+    png_write_chunk(file, "IDAT", zlib, zlibSize);
+    png_write_chunk(file, "IEND", NULL, 0);
+
+    bool ok = (ferror(file) == 0);
+
+    free(zlib);
+    free(raw);
+    free(rgb);
+    fclose(file);
+    return ok;
 }
 
 /* Console Function Implementation */
 
 internal void 
 console_clear(Console *con) {
-    UIRect r = {0, 0, con->width, con->height};
-    ui_fill(con->pixels, con->width, &r, con->bgColor);
+    // Reset the logical model - pixels are only touched by console_rasterize
+    memset(con->cells, 0, con->rowCount * con->colCount * sizeof(ConsoleCellStack));
+}
+
+internal void
+console_invalidate(Console *con) {
+    // Force every cell to be re-rasterized on the next console_rasterize
+    u32 cellCount = con->rowCount * con->colCount;
+    for (u32 i = 0; i < cellCount; i++) {
+        con->drawnCells[i].layerCount = CONSOLE_CELL_INVALID;
+    }
 }
 
 internal Console *
 console_new(i32 width, i32 height, 
             i32 rowCount, i32 colCount,
-            u32 bgColor, bool colorize) {
+            u32 bgColor, bool colorize,
+            u32 *pixels, u32 pitch) {
     
     Console *con = calloc(1, sizeof(Console));
 
-    con->pixels = calloc(width * height, sizeof(u32));
+    // Draw into the given pixels if there are any, otherwise into our own
+    if (pixels != NULL) {
+        con->pixels = pixels;
+        con->pitch = pitch;
+        con->ownsPixels = false;
+    } else {
+        con->pixels = calloc(width * height, sizeof(u32));
+        con->pitch = width;
+        con->ownsPixels = true;
+    }
     con->width = width;
     con->height = height;
     con->rowCount = rowCount;
@@ -250,15 +764,20 @@ console_new(i32 width, i32 height,
     con->font = NULL;
     con->bgColor = bgColor;
     con->colorize = colorize;
-    con->cells = calloc(rowCount * colCount, sizeof(ConsoleCell));
+    con->cells = calloc(rowCount * colCount, sizeof(ConsoleCellStack));
+    con->drawnCells = calloc(rowCount * colCount, sizeof(ConsoleCellStack));
+    con->tileCaches = tile_cache_set_acquire(con->cellWidth, con->cellHeight);
+    console_invalidate(con);
 
     return con;
 }
 
 internal void
 console_destroy(Console *con) {
-    if (con->pixels) { free(con->pixels); }
+    if (con->pixels && con->ownsPixels) { free(con->pixels); }
     if (con->cells) { free(con->cells); }
+    if (con->drawnCells) { free(con->drawnCells); }
+    if (con->font) { font_release(con->font); }
     if (con) { free(con); }
 }
 
@@ -267,18 +786,47 @@ console_put_char_at(Console *con, asciiChar c,
                     i32 cellX, i32 cellY,
                     u32 fgColor, u32 bgColor) {
 
-    i32 x = cellX * con->cellWidth;
-    i32 y = cellY * con->cellHeight;
-    UIRect destRect = {x, y, con->cellWidth, con->cellHeight};
+    if ((cellX < 0) || (cellX >= (i32)con->colCount) || 
+        (cellY < 0) || (cellY >= (i32)con->rowCount)) {
+        return;
+    }
+
+    // Record the glyph in the cell model. It gets rasterized later, and only 
+    // if the cell ends up different from what was drawn last time.
+    ConsoleCellStack *stack = &con->cells[cellY * con->colCount + cellX];
+    if (ALPHA(bgColor) == 255) {
+        // An opaque background hides everything beneath it
+        stack->image = NULL;
+        stack->layerCount = 0;
+
+    } else if (stack->layerCount == CONSOLE_CELL_LAYERS) {
+        memmove(&stack->layers[0], &stack->layers[1], 
+                (CONSOLE_CELL_LAYERS - 1) * sizeof(ConsoleCell));
+        stack->layerCount -= 1;
+    }
+
+    ConsoleCell *cell = &stack->layers[stack->layerCount];
+    cell->glyph = c;
+    cell->fgColor = fgColor;
+    cell->bgColor = bgColor;
+    stack->layerCount += 1;
+}
 
-    // Fill the background with alpha blending
-    ui_fill_blend(con->pixels, con->width, &destRect, bgColor);
+internal void
+console_put_image_cell_at(Console *con, BitmapImage *image, 
+                          u32 imageX, u32 imageY, i32 cellX, i32 cellY) {
+    // Use a cell-sized slice of image, from (imageX, imageY), as the backdrop 
+    // of a cell. It replaces anything drawn there so far.
+    if ((cellX < 0) || (cellX >= (i32)con->colCount) || 
+        (cellY < 0) || (cellY >= (i32)con->rowCount)) {
+        return;
+    }
 
-    // Copy the glyph with alpha blending and desired coloring
-    UIRect srcRect = rect_get_for_glyph(c, con->font);
-    ui_copy_blend(con->pixels, &destRect, con->width, 
-                con->font->atlas, &srcRect, con->font->atlasWidth,
-                con->colorize, &fgColor);
+    ConsoleCellStack *stack = &con->cells[cellY * con->colCount + cellX];
+    stack->image = image;
+    stack->imageX = imageX;
+    stack->imageY = imageY;
+    stack->layerCount = 0;
 }
 
 internal void 
@@ -321,149 +869,573 @@ console_put_string_in_rect(Console *con, char *string,
     }
 }
 
-internal void 
-console_set_bitmap_font(Console *con, char *filename, 
-                        asciiChar firstCharInAtlas,
-                        i32 charWidth, i32 charHeight) {
+internal bool
+console_cell_stacks_equal(ConsoleCellStack *a, ConsoleCellStack *b) {
+    if ((a->layerCount != b->layerCount) || (a->image != b->image)) {
+        return false;
+    }
+    if ((a->image != NULL) && ((a->imageX != b->imageX) || (a->imageY != b->imageY))) {
+        return false;
+    }
+    for (u32 i = 0; i < a->layerCount; i++) {
+        ConsoleCell *ca = &a->layers[i];
+        ConsoleCell *cb = &b->layers[i];
+        if ((ca->glyph != cb->glyph) || (ca->fgColor != cb->fgColor) || 
+            (ca->bgColor != cb->bgColor)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+internal void
+console_rasterize_cell(Console *con, TileCache *tileCache, u32 cellX, u32 cellY) {
+    ConsoleCellStack *stack = &con->cells[cellY * con->colCount + cellX];
+    UIRect destRect = {cellX * con->cellWidth, cellY * con->cellHeight, 
+                       con->cellWidth, con->cellHeight};
+
+    u32 firstLayer = 0;
+    if ((stack->image == NULL) && (stack->layerCount > 0)) {
+        // The bottom glyph sits on a solid color, so it can come straight 
+        // from the tile cache
+        ConsoleCell *cell = &stack->layers[0];
+        u32 baseColor = con->bgColor;
+        UIRect pixelRect = {0, 0, 1, 1};
+        ui_fill_blend(&baseColor, 1, &pixelRect, cell->bgColor);
+
+        bool found = false;
+        u32 *tile = tile_cache_get(tileCache, con->font, cell->glyph, cell->fgColor, 
+                                   baseColor, con->colorize, &found);
+        UIRect tileRect = {0, 0, con->cellWidth, con->cellHeight};
+        if (!found) {
+            ui_fill(tile, con->cellWidth, &tileRect, baseColor);
+            font_blend_glyph(con->font, cell->glyph, cell->fgColor,
+                             tile, &tileRect, con->cellWidth);
+        }
+        for (u32 y = 0; y < con->cellHeight; y++) {
+            memcpy(&con->pixels[((destRect.y + y) * con->pitch) + destRect.x],
+                   &tile[y * con->cellWidth], con->cellWidth * sizeof(u32));
+        }
+        firstLayer = 1;
+
+    } else {
+        // Start from the console background, or the bitmap backdrop if there is 
+        // one. A backdrop that covers the whole cell is copied over it anyway.
+        BitmapImage *img = stack->image;
+        bool imageCoversCell = (img != NULL) && 
+                               (stack->imageX + con->cellWidth <= img->width) && 
+                               (stack->imageY + con->cellHeight <= img->height);
+        if (!imageCoversCell) {
+            ui_fill(con->pixels, con->pitch, &destRect, con->bgColor);
+        }
+    }
+
+    if (stack->image != NULL) {
+        BitmapImage *img = stack->image;
+        u32 w = con->cellWidth;
+        if (stack->imageX + w > img->width) { w = img->width - stack->imageX; }
+        u32 h = con->cellHeight;
+        if (stack->imageY + h > img->height) { h = img->height - stack->imageY; }
+        for (u32 y = 0; y < h; y++) {
+            memcpy(&con->pixels[((destRect.y + y) * con->pitch) + destRect.x],
+                   &img->pixels[((stack->imageY + y) * img->width) + stack->imageX],
+                   w * sizeof(u32));
+        }
+    }
+
+    // Then blend each glyph on top, in the order they were drawn
+    for (u32 i = firstLayer; i < stack->layerCount; i++) {
+        ConsoleCell *cell = &stack->layers[i];
+
+        // Fill the background with alpha blending
+        ui_fill_blend(con->pixels, con->pitch, &destRect, cell->bgColor);
+
+        // Copy the glyph with alpha blending and desired coloring
+        font_blend_glyph(con->font, cell->glyph, cell->fgColor,
+                         con->pixels, &destRect, con->pitch);
+    }
+}
+
+internal void
+console_rasterize_band(void *data, u32 band) {
+    // Each band covers a run of whole rows, and has a tile cache of its own, 
+    // so bands never touch the same memory. Consoles are rasterized one at a 
+    // time, so they can share the band caches.
+    ConsoleRasterJob *job = (ConsoleRasterJob *)data;
+    Console *con = job->con;
+    u32 startY = (con->rowCount * band) / job->bandCount;
+    u32 stopY = (con->rowCount * (band + 1)) / job->bandCount;
+
+    TileCacheSet *set = con->tileCaches;
+    if (set->caches[band] == NULL) {
+        set->caches[band] = tile_cache_new(set->tileWidth, set->tileHeight);
+    }
+    TileCache *tileCache = set->caches[band];
+
+    // Only re-rasterize the cells whose contents changed since the last call
+    u32 minX = con->colCount, minY = stopY, maxX = 0, maxY = 0;
+    u32 cellCount = 0;
+    for (u32 cellY = startY; cellY < stopY; cellY++) {
+        for (u32 cellX = 0; cellX < con->colCount; cellX++) {
+            u32 idx = cellY * con->colCount + cellX;
+            if (!console_cell_stacks_equal(&con->cells[idx], &con->drawnCells[idx])) {
+                console_rasterize_cell(con, tileCache, cellX, cellY);
+                con->drawnCells[idx] = con->cells[idx];
+                cellCount += 1;
+
+                if (cellX < minX) { minX = cellX; }
+                if (cellX > maxX) { maxX = cellX; }
+                if (cellY < minY) { minY = cellY; }
+                maxY = cellY;
+            }
+        }
+    }
+
+    UIRect changed = {0, 0, 0, 0};
+    if (minY < stopY) {
+        changed.x = minX;
+        changed.y = minY;
+        changed.w = maxX - minX + 1;
+        changed.h = maxY - minY + 1;
+    }
+    job->changed[band] = changed;
+    job->cellCount[band] = cellCount;
+}
+
+internal UIRect
+console_rasterize(Console *con) {
+    // Split the console into row bands and rasterize them on the worker 
+    // pool. Cells come out the same no matter which band draws them.
+    // Returns the pixel area that was redrawn.
+    ConsoleRasterJob job;
+    job.con = con;
+    job.bandCount = worker_pool_thread_count();
+    if (job.bandCount > con->rowCount) { job.bandCount = con->rowCount; }
+    worker_pool_run(console_rasterize_band, &job, job.bandCount);
+
+    UIRect changed = {0, 0, 0, 0};
+    for (u32 i = 0; i < job.bandCount; i++) {
+        rasterStats.cellCount += job.cellCount[i];
+        rasterStats.pixelCount += (u64)job.cellCount[i] * con->cellWidth * con->cellHeight;
+        if (job.changed[i].w == 0) { continue; }
+        if (changed.w == 0) {
+            changed = job.changed[i];
+        } else {
+            SDL_UnionRect(&changed, &job.changed[i], &changed);
+        }
+    }
+    changed.x *= con->cellWidth;
+    changed.y *= con->cellHeight;
+    changed.w *= con->cellWidth;
+    changed.h *= con->cellHeight;
+
+    return changed;
+}
+
+internal void 
+console_set_bitmap_font(Console *con, char *filename, 
+                        asciiChar firstCharInAtlas,
+                        i32 charWidth, i32 charHeight) {
+
+    // Grab the new font before letting go of the old one, so switching 
+    // to the font we already have doesn't reload it
+    ConsoleFont *font = font_acquire(filename, firstCharInAtlas, charWidth, charHeight, 
+                                     con->colorize);
+    if (con->font != NULL) {
+        font_release(con->font);
+    }
+    if (con->font == font) {
+        return;
+    }
+
+    con->font = font;
+    console_invalidate(con);
+}
+
+
+/* Font Function Implementation */
+
+internal ConsoleFont *
+font_load(char *filename, asciiChar firstCharInAtlas,
+          u32 charWidth, u32 charHeight, bool colorize) {
+
+    ConsoleFont *font = calloc(1, sizeof(ConsoleFont));
+    font->charWidth = charWidth;
+    font->charHeight = charHeight;
+    font->firstCharInAtlas = firstCharInAtlas;    
+    font->colorize = colorize;
+    font->filename = calloc(strlen(filename) + 1, sizeof(char));
+    strcpy(font->filename, filename);
+
+    // The asset pack has the atlas ready to use, if it's up to date
+    AssetKind kind = colorize ? ASSET_FONT_COVERAGE : ASSET_FONT_ATLAS;
+    u32 bytesPerPixel = colorize ? sizeof(u8) : sizeof(u32);
+    AssetPackEntry *entry = asset_pack_find(kind, filename, NULL, charWidth, charHeight);
+    if ((entry != NULL) && (entry->dataSize == entry->width * entry->height * bytesPerPixel)) {
+        if (colorize) {
+            font->coverage = (u8 *)asset_pack_entry_data(entry);
+        } else {
+            font->atlas = (u32 *)asset_pack_entry_data(entry);
+        }
+        font->ownsAtlas = false;
+        font->atlasWidth = entry->width;
+        font->atlasHeight = entry->height;
+        return font;
+    }
+
+    // Load the image data
+    int imgWidth, imgHeight, numComponents;
+    unsigned char *imgData = stbi_load(filename, 
+                                    &imgWidth, &imgHeight, 
+                                    &numComponents, STBI_rgb_alpha);
+
+    // Copy the image data so we can hold onto it
+    u32 imgDataSize = imgWidth * imgHeight * sizeof(u32);
+    u32 *atlasData = calloc(imgDataSize, sizeof(u32));
+    memcpy(atlasData, imgData, imgDataSize);
+
+    // Swap endianness of data if we need to
+    u32 pixelCount = imgWidth * imgHeight;
+    if (system_is_little_endian()) {
+        for (u32 i = 0; i < pixelCount; i++) {
+            atlasData[i] = SWAP_U32(atlasData[i]);
+        }        
+    }
+
+    // Turn all black pixels into transparent pixels
+    for (u32 i = 0; i < pixelCount; i++) {
+        if (atlasData[i] == 0x000000ff) { 
+            atlasData[i] = 0x00000000; 
+        }
+    }        
+
+    if (colorize) {
+        // Colorizing only ever looks at the alpha of each pixel, so that's 
+        // all that is kept - a quarter of the memory to read per glyph
+        font->coverage = calloc(pixelCount, sizeof(u8));
+        for (u32 i = 0; i < pixelCount; i++) {
+            font->coverage[i] = ALPHA(atlasData[i]);
+        }
+        free(atlasData);
+    } else {
+        font->atlas = atlasData;
+    }
+    font->ownsAtlas = true;
+    font->atlasWidth = imgWidth;
+    font->atlasHeight = imgHeight;
+
+    stbi_image_free(imgData);
+
+    return font;
+}
+
+internal void
+font_registry_init() {
+    if (fontRegistry == NULL) {
+        fontRegistry = list_new(NULL);
+        fontRegistryLock = SDL_CreateMutex();
+    }
+}
+
+internal ConsoleFont *
+font_acquire(char *filename, asciiChar firstCharInAtlas,
+             u32 charWidth, u32 charHeight, bool colorize) {
+
+    // Each font atlas is only decoded once per process - consoles using 
+    // the same file, char size and coloring share it. The lock is held while loading, 
+    // so asking for a font that's being loaded in the background waits for it.
+    font_registry_init();
+    SDL_LockMutex(fontRegistryLock);
+
+    for (ListElement *e = list_head(fontRegistry); e != NULL; e = list_next(e)) {
+        ConsoleFont *font = (ConsoleFont *)list_data(e);
+        if ((font->charWidth == charWidth) && (font->charHeight == charHeight) &&
+            (font->firstCharInAtlas == firstCharInAtlas) && 
+            (font->colorize == colorize) && (strcmp(font->filename, filename) == 0)) {
+            font->refCount += 1;
+            SDL_UnlockMutex(fontRegistryLock);
+            return font;
+        }
+    }
+
+    ConsoleFont *font = font_load(filename, firstCharInAtlas, charWidth, charHeight, colorize);
+    font->refCount = 1;
+    list_insert_after(fontRegistry, NULL, font);
+
+    SDL_UnlockMutex(fontRegistryLock);
+    return font;
+}
+
+internal void
+font_release(ConsoleFont *font) {
+    SDL_LockMutex(fontRegistryLock);
+    assert(font->refCount > 0);
+    font->refCount -= 1;
+    if (font->refCount == 0) {
+        list_remove_element_with_data(fontRegistry, font);
+        if (font->ownsAtlas) { 
+            free(font->atlas); 
+            free(font->coverage);
+        }
+        free(font->glyphShapes);
+        free(font->filename);
+        free(font);
+
+        // A font loaded later could end up at the same address
+        tile_cache_sets_clear();
+    }
+    SDL_UnlockMutex(fontRegistryLock);
+}
+
+
+/* Tile Cache Function Implementation */
+
+internal TileCache *
+tile_cache_new(u32 tileWidth, u32 tileHeight) {
+    TileCache *cache = calloc(1, sizeof(TileCache));
+    cache->tileWidth = tileWidth;
+    cache->tileHeight = tileHeight;
+    cache->pixels = calloc(TILE_CACHE_CAPACITY * tileWidth * tileHeight, sizeof(u32));
+    for (u32 i = 0; i < TILE_CACHE_CAPACITY; i++) {
+        cache->tiles[i].pixels = &cache->pixels[i * tileWidth * tileHeight];
+    }
+    tile_cache_clear(cache);
+
+    return cache;
+}
+
+internal void
+tile_cache_clear(TileCache *cache) {
+    // Drop every tile - needed whenever a font the tiles came from is freed
+    cache->count = 0;
+    cache->lruHead = TILE_NONE;
+    cache->lruTail = TILE_NONE;
+    for (u32 i = 0; i < TILE_CACHE_BUCKETS; i++) {
+        cache->buckets[i] = TILE_NONE;
+    }
+}
+
+internal TileCacheSet *
+tile_cache_set_acquire(u32 tileWidth, u32 tileHeight) {
+    // Sets are made the first time a cell size is seen, and kept for good - 
+    // there are only ever a few sizes. The asset loader makes consoles too, 
+    // so the list is guarded by the font lock, which clearing already holds.
+    font_registry_init();
+    SDL_LockMutex(fontRegistryLock);
+    if (tileCacheSets == NULL) {
+        tileCacheSets = list_new(NULL);
+    }
+    for (ListElement *e = list_head(tileCacheSets); e != NULL; e = list_next(e)) {
+        TileCacheSet *set = (TileCacheSet *)list_data(e);
+        if ((set->tileWidth == tileWidth) && (set->tileHeight == tileHeight)) {
+            SDL_UnlockMutex(fontRegistryLock);
+            return set;
+        }
+    }
 
-    // Load the image data
-    int imgWidth, imgHeight, numComponents;
-    unsigned char *imgData = stbi_load(filename, 
-                                    &imgWidth, &imgHeight, 
-                                    &numComponents, STBI_rgb_alpha);
+    TileCacheSet *set = calloc(1, sizeof(TileCacheSet));
+    set->tileWidth = tileWidth;
+    set->tileHeight = tileHeight;
+    list_insert_after(tileCacheSets, NULL, set);
 
-    // Copy the image data so we can hold onto it
-    u32 imgDataSize = imgWidth * imgHeight * sizeof(u32);
-    u32 *atlasData = calloc(imgDataSize, sizeof(u32));
-    memcpy(atlasData, imgData, imgDataSize);
+    SDL_UnlockMutex(fontRegistryLock);
+    return set;
+}
 
-    // Swap endianness of data if we need to
-    u32 pixelCount = imgWidth * imgHeight;
-    if (system_is_little_endian()) {
-        for (u32 i = 0; i < pixelCount; i++) {
-            atlasData[i] = SWAP_U32(atlasData[i]);
-        }        
+internal void
+tile_cache_sets_clear() {
+    if (tileCacheSets == NULL) { return; }
+    for (ListElement *e = list_head(tileCacheSets); e != NULL; e = list_next(e)) {
+        TileCacheSet *set = (TileCacheSet *)list_data(e);
+        for (u32 i = 0; i < WORKER_THREADS_MAX; i++) {
+            if (set->caches[i]) { tile_cache_clear(set->caches[i]); }
+        }
     }
+}
 
-    // Turn all black pixels into transparent pixels
-    for (u32 i = 0; i < pixelCount; i++) {
-        if (atlasData[i] == 0x000000ff) { 
-            atlasData[i] = 0x00000000; 
-        }
-    }        
+internal u32
+tile_cache_bucket(ConsoleFont *font, asciiChar glyph, u32 fgColor, u32 bgColor, bool colorize) {
+    u32 h = 2166136261u;
+    h = (h ^ (u32)(uintptr_t)font) * 16777619u;
+    h = (h ^ glyph) * 16777619u;
+    h = (h ^ fgColor) * 16777619u;
+    h = (h ^ bgColor) * 16777619u;
+    h = (h ^ colorize) * 16777619u;
+    return h & (TILE_CACHE_BUCKETS - 1);
+}
 
-    // Create and configure the font
-    ConsoleFont *font = calloc(1, sizeof(ConsoleFont));
-    font->atlas = atlasData;
-    font->charWidth = charWidth;
-    font->charHeight = charHeight;
-    font->atlasWidth = imgWidth;
-    font->atlasHeight = imgHeight;
-    font->firstCharInAtlas = firstCharInAtlas;    
+internal void
+tile_cache_lru_unlink(TileCache *cache, i32 idx) {
+    CachedTile *tile = &cache->tiles[idx];
+    if (tile->lruPrev != TILE_NONE) { 
+        cache->tiles[tile->lruPrev].lruNext = tile->lruNext; 
+    } else {
+        cache->lruHead = tile->lruNext;
+    }
+    if (tile->lruNext != TILE_NONE) { 
+        cache->tiles[tile->lruNext].lruPrev = tile->lruPrev; 
+    } else {
+        cache->lruTail = tile->lruPrev;
+    }
+}
 
-    stbi_image_free(imgData);
+internal void
+tile_cache_lru_push(TileCache *cache, i32 idx) {
+    CachedTile *tile = &cache->tiles[idx];
+    tile->lruPrev = TILE_NONE;
+    tile->lruNext = cache->lruHead;
+    if (cache->lruHead != TILE_NONE) { 
+        cache->tiles[cache->lruHead].lruPrev = idx; 
+    } else {
+        cache->lruTail = idx;
+    }
+    cache->lruHead = idx;
+}
 
-    if (con->font != NULL) {
-        free(con->font->atlas);
-        free(con->font);
+internal u32 *
+tile_cache_get(TileCache *cache, ConsoleFont *font, asciiChar glyph, u32 fgColor, 
+               u32 bgColor, bool colorize, bool *found) {
+    // Returns the pixels for the given tile. If the tile wasn't cached, found 
+    // is set to false and the caller is expected to render into the pixels.
+    u32 bucket = tile_cache_bucket(font, glyph, fgColor, bgColor, colorize);
+    for (i32 idx = cache->buckets[bucket]; idx != TILE_NONE; idx = cache->tiles[idx].hashNext) {
+        CachedTile *tile = &cache->tiles[idx];
+        if ((tile->font == font) && (tile->glyph == glyph) && (tile->fgColor == fgColor) && 
+            (tile->bgColor == bgColor) && (tile->colorize == colorize)) {
+            tile_cache_lru_unlink(cache, idx);
+            tile_cache_lru_push(cache, idx);
+            cache->hits += 1;
+            *found = true;
+            return tile->pixels;
+        }
     }
-    con->font = font;
+
+    // Miss - grab an unused tile, or evict the least recently used one
+    i32 idx;
+    if (cache->count < TILE_CACHE_CAPACITY) {
+        idx = cache->count;
+        cache->count += 1;
+    } else {
+        idx = cache->lruTail;
+        tile_cache_lru_unlink(cache, idx);
+
+        CachedTile *old = &cache->tiles[idx];
+        i32 *link = &cache->buckets[tile_cache_bucket(old->font, old->glyph, old->fgColor, 
+                                                      old->bgColor, old->colorize)];
+        while (*link != idx) {
+            link = &cache->tiles[*link].hashNext;
+        }
+        *link = old->hashNext;
+    }
+
+    CachedTile *tile = &cache->tiles[idx];
+    tile->font = font;
+    tile->glyph = glyph;
+    tile->fgColor = fgColor;
+    tile->bgColor = bgColor;
+    tile->colorize = colorize;
+    tile->hashNext = cache->buckets[bucket];
+    cache->buckets[bucket] = idx;
+    tile_cache_lru_push(cache, idx);
+
+    cache->misses += 1;
+    *found = false;
+    return tile->pixels;
 }
 
 
 /* Image Functions */
 
+// Work shared by the threads asciifying an image, one row of cells per task
+typedef struct {
+    Console *con;
+    BitmapImage *image;
+    AsciiImage *asciiImg;
+} AsciifyJob;
+
+internal void
+asciify_row(void *data, u32 row) {
+    AsciifyJob *job = (AsciifyJob *)data;
+    Console *con = job->con;
+    AsciiImage *asciiImg = job->asciiImg;
+
+    for (u32 c = 0; c < asciiImg->cols; c++) {
+        // Work on the cell straight out of the source image
+        UIRect cellRect = {.x = c * con->cellWidth, .y = row * con->cellHeight, 
+                           .w = con->cellWidth, .h = con->cellHeight};
+
+        // Analyze each cell to determine primary & secondary colors
+        u32 primaryColor = 0;
+        u32 secondaryColor = 0;
+        image_analyze_colors(job->image, &cellRect, &primaryColor, &secondaryColor);
+
+        if (primaryColor == 0x00000000) {
+            u32 tmp = secondaryColor;
+            secondaryColor = primaryColor;
+            primaryColor = tmp;
+        }
+
+        // Create a "1-bit" representation of the graphic indicating the "shape" of the cell
+        GlyphShape mask;
+        image_mask_create(job->image, &cellRect, primaryColor, secondaryColor, &mask);
+
+        // Determine the best fit glyph for the cell shape
+        asciiChar glyph = image_match_glyph(con->font, &mask);
+
+        // Render that glyph into a cell of the ascii image
+        ConsoleCell *cCell = &asciiImg->cells[row * asciiImg->cols + c];
+        cCell->glyph = glyph;
+        if (glyph == ' ') {
+            // Single color cell
+            cCell->fgColor = secondaryColor;
+            cCell->bgColor = primaryColor;
+        } else {
+            cCell->fgColor = primaryColor;
+            cCell->bgColor = secondaryColor;
+        }
+    }
+}
+
 internal AsciiImage*
 asciify_bitmap(Console *con, BitmapImage *image) {
     assert(image->height % con->cellHeight == 0);
     assert(image->width % con->cellWidth == 0);
+    assert(con->cellWidth * con->cellHeight <= GLYPH_SHAPE_BITS);
 
     i32 rows = image->height / con->cellHeight;
     i32 cols = image->width / con->cellWidth;
 
     AsciiImage *asciiImg = calloc(1, sizeof(AsciiImage));
-    asciiImg->cells = calloc(rows * cols, sizeof(ConsoleCell));
     asciiImg->rows = rows;
     asciiImg->cols = cols;
 
-    // Break the given bitmap image into cells
-    BitmapImage *cells = image_slice(image, rows, cols);
-
-    // Loop through all cells
-    for (i32 r = 0; r < rows; r++) {
-        for (i32 c = 0; c < cols; c++) {
-            // Analyze each cell to determine primary & secondary colors
-            u32 primaryColor = 0;
-            u32 secondaryColor = 0;
-
-            BitmapImage *cellImage = &cells[r * cols + c];
-            image_analyze_colors(cellImage, &primaryColor, &secondaryColor);
-
-            if (primaryColor == 0x00000000) {
-                u32 tmp = secondaryColor;
-                secondaryColor = primaryColor;
-                primaryColor = tmp;
-            }
-
-            // Create a "1-bit" representation of the graphic indicating the "shape" of the cell
-            BitmapImage *maskImage = image_mask_create(cellImage, primaryColor, secondaryColor);
-
-            // Determine the best fit glyph for the cell shape
-            asciiChar glyph = image_match_glyph(con, maskImage);
-
-            // We're done with the mask
-            free(maskImage);
+    // Use the cells from the asset pack if it has this image asciified 
+    // with the same font
+    if (image->filename != NULL) {
+        AssetPackEntry *entry = asset_pack_find(ASSET_ASCII_IMAGE, image->filename, 
+                                                con->font->filename, 
+                                                con->cellWidth, con->cellHeight);
+        if ((entry != NULL) && (entry->width == (u32)cols) && (entry->height == (u32)rows) && 
+            (entry->dataSize == rows * cols * sizeof(ConsoleCell))) {
+            asciiImg->cells = (ConsoleCell *)asset_pack_entry_data(entry);
+            return asciiImg;
+        }
+    }
 
-            // printf("Best glyph: %c\n", glyph);
+    asciiImg->cells = calloc(rows * cols, sizeof(ConsoleCell));
 
-            // Render that glyph into a cell of the ascii image
-            ConsoleCell *cCell = &asciiImg->cells[r * cols + c];
-            cCell->glyph = glyph;
-            if (glyph == ' ') {
-                // Single color cell
-                cCell->fgColor = secondaryColor;
-                cCell->bgColor = primaryColor;
-            } else {
-                cCell->fgColor = primaryColor;
-                cCell->bgColor = secondaryColor;
-            }
+    // Glyph shapes are built here, before the threads start reading them
+    SDL_LockMutex(fontRegistryLock);
+    font_build_glyph_shapes(con->font);
+    SDL_UnlockMutex(fontRegistryLock);
 
-        }
-    }
+    // Cells are independent of each other, so rows can be done in parallel
+    AsciifyJob job = {.con = con, .image = image, .asciiImg = asciiImg};
+    worker_pool_run(asciify_row, &job, rows);
 
-    // Free the memory in each cell's pixels
-	// TODO: - DEBUG
-    // for (i32 c = 0; c < (rows * cols); c++) {
-    //     BitmapImage *bm = &cells[c];
-    //     free(bm->pixels);
-    // }
-    free(cells);
     return asciiImg;
 }
 
-internal BitmapImage *
-image_slice(BitmapImage *img, i32 rows, i32 cols) {
-    // Slice the given image into a 2D array of image cells
-    i32 cellWidth = img->width / cols;
-    i32 cellHeight = img->height / rows;
-    BitmapImage *cells = calloc(rows * cols, sizeof(BitmapImage));
-    for (i32 cellY = 0; cellY < rows; cellY++) {
-        for (i32 cellX = 0; cellX < cols; cellX++) {
-            BitmapImage *cellBM = &cells[(cellY * cols) + cellX];
-            cellBM->width = cellWidth;
-            cellBM->height = cellHeight;
-            cellBM->pixels = calloc(cellWidth * cellHeight, sizeof(u32));
-
-            for (i32 y = 0; y < cellHeight; y++) {
-                memcpy(&cellBM->pixels[y * cellWidth], 
-                    &img->pixels[(((cellY * cellHeight) + y) * img->width) + (cellX * cellWidth)], 
-                    cellWidth * sizeof(u32));
-            }
-        }
-    }
-    return cells;
-}
-
 internal u32
 rgbdist(u32 color1, u32 color2) {
     i32 dr = RED(color1) - RED(color2);
@@ -481,31 +1453,42 @@ colors_are_distinct(u32 color1, u32 color2) {
     return false;
 }
 
+// Size of the hash table used to count the colors in a cell. Must be a power 
+// of two, and bigger than the number of pixels in a cell.
+#define COLOR_HISTOGRAM_BUCKETS     512
+#define COLOR_HISTOGRAM_EMPTY       0xffff
+
 internal void 
-image_analyze_colors(BitmapImage *image, u32 *primaryColor, u32 *secondaryColor) {
-    // Determine primary and secondary colors for the given image.
+image_analyze_colors(BitmapImage *image, UIRect *cellRect, 
+                     u32 *primaryColor, u32 *secondaryColor) {
+    // Determine primary and secondary colors for the given cell of the image.
     // The colors should be distinct enough to be distiguishable.
-
-    // Step one - count color occurrences
-    u32 *colors = calloc(image->width * image->height, sizeof(u32));
-    u32 *counts = calloc(image->width * image->height, sizeof(u32));
+    assert(cellRect->w * cellRect->h < COLOR_HISTOGRAM_BUCKETS);
+
+    // Step one - count color occurrences. Colors are kept in the order they 
+    // were first seen, with a small hash table to find them again.
+    u32 colors[COLOR_HISTOGRAM_BUCKETS];
+    u32 counts[COLOR_HISTOGRAM_BUCKETS];
+    u16 buckets[COLOR_HISTOGRAM_BUCKETS];
+    memset(buckets, 0xff, sizeof(buckets));
     u32 numColors = 0;
 
-    for (u32 y = 0; y < image->height; y++) {
-        for (u32 x = 0; x < image->width; x++) {
+    for (i32 y = cellRect->y; y < cellRect->y + cellRect->h; y++) {
+        u32 *row = &image->pixels[y * image->width];
+        for (i32 x = cellRect->x; x < cellRect->x + cellRect->w; x++) {
             // Grab the pixel color
-            u32 pixelColor = image->pixels[(y * image->width) + x];
-
-            bool alreadySeen = false;
-            for (u32 i = 0; i < numColors; i++) {
-                if (colors[i] == pixelColor) {
-                    alreadySeen = true;
-                    counts[i] += 1;
-                    break;
-                }
+            u32 pixelColor = row[x];
+
+            u32 bucket = ((pixelColor * 0x9e3779b1) >> 23) & (COLOR_HISTOGRAM_BUCKETS - 1);
+            while ((buckets[bucket] != COLOR_HISTOGRAM_EMPTY) && 
+                   (colors[buckets[bucket]] != pixelColor)) {
+                bucket = (bucket + 1) & (COLOR_HISTOGRAM_BUCKETS - 1);
             }
 
-            if (!alreadySeen) {
+            if (buckets[bucket] != COLOR_HISTOGRAM_EMPTY) {
+                counts[buckets[bucket]] += 1;
+            } else {
+                buckets[bucket] = numColors;
                 colors[numColors] = pixelColor;
                 counts[numColors] = 1;
                 numColors += 1;
@@ -544,13 +1527,23 @@ image_analyze_colors(BitmapImage *image, u32 *primaryColor, u32 *secondaryColor)
         // We only have one color
         *secondaryColor = 0x00000000;
     }
-
-    free(colors);
-    free(counts);
 }
 
 internal BitmapImage*
 image_load_from_file(char *filename) {
+    BitmapImage *bmi = calloc(1, sizeof(BitmapImage));
+    bmi->filename = calloc(strlen(filename) + 1, sizeof(char));
+    strcpy(bmi->filename, filename);
+
+    // The asset pack has the pixels ready to use, if it's up to date
+    AssetPackEntry *entry = asset_pack_find(ASSET_BITMAP, filename, NULL, 0, 0);
+    if ((entry != NULL) && (entry->dataSize == entry->width * entry->height * sizeof(u32))) {
+        bmi->pixels = (u32 *)asset_pack_entry_data(entry);
+        bmi->width = entry->width;
+        bmi->height = entry->height;
+        return bmi;
+    }
+
     // Load the image data
     int imgWidth, imgHeight, numComponents;
     unsigned char *imgData = stbi_load(filename, 
@@ -570,7 +1563,6 @@ image_load_from_file(char *filename) {
         }        
     }
 
-    BitmapImage *bmi = calloc(1, sizeof(BitmapImage));
     bmi->pixels = imageData;
     bmi->width = imgWidth;
     bmi->height = imgHeight;
@@ -580,63 +1572,91 @@ image_load_from_file(char *filename) {
     return bmi;
 }
 
-internal BitmapImage *
-image_mask_create(BitmapImage *origImage, u32 primaryColor, u32 secondaryColor) 
+internal void
+image_mask_create(BitmapImage *image, UIRect *cellRect, 
+                  u32 primaryColor, u32 secondaryColor, GlyphShape *mask) 
 {
-    // Create a "1-bit" version of the given image
-    BitmapImage *maskImage = calloc(1, sizeof(BitmapImage));
-    maskImage->width = origImage->width;
-    maskImage->height = origImage->height;
-    maskImage->pixels = calloc(origImage->width * origImage->height, sizeof(u32));
-
-    for (u32 y = 0; y < origImage->height; y++) {
-        for (u32 x = 0; x < origImage->width; x++) {
-            u32 pixelColor = origImage->pixels[y * origImage->width + x];
+    // Create a "1-bit" version of the given cell, with a bit set for each 
+    // pixel closer to the primary color
+    memset(mask, 0, sizeof(GlyphShape));
+
+    u32 bit = 0;
+    for (i32 y = cellRect->y; y < cellRect->y + cellRect->h; y++) {
+        u32 *row = &image->pixels[y * image->width];
+        for (i32 x = cellRect->x; x < cellRect->x + cellRect->w; x++) {
+            u32 pixelColor = row[x];
             if (rgbdist(pixelColor, primaryColor) <= rgbdist(pixelColor, secondaryColor)) {
-                maskImage->pixels[y * origImage->width + x] = 0xFFFFFFFF;
-            } else {
-                maskImage->pixels[y * origImage->width + x] = 0x00000000;
+                mask->bits[bit / 64] |= (u64)1 << (bit % 64);
             }
+            bit += 1;
         }
     }
-
-    return maskImage;
 }
 
-internal asciiChar
-image_match_glyph(Console *console, BitmapImage *maskImage) {
-    ConsoleFont *font = console->font;
-    u32 fontCols = font->atlasWidth / font->charWidth;
-
-    i32 matchCount = 0;
-    asciiChar bestMatch = 0;
-
-    asciiChar drawingGlyphs[] = {0, 219, 220, 221, 222, 223, 226, 227, 228, 229, 230, 231};
-    u32 drawingGlyphCount = 12;
-
-    // Loop through all drawing glyphs, looking for the best match to the mask image
-    for (u32 dgi = 0; dgi < drawingGlyphCount; dgi++) {
-        u32 cellY = drawingGlyphs[dgi] / 16;
-        u32 cellX = drawingGlyphs[dgi] % 16;
+internal void
+font_build_glyph_shapes(ConsoleFont *font) {
+    // Build a 1-bit shape for every glyph in the atlas, with a bit set for 
+    // each of the glyph's foreground pixels
+    if (font->glyphShapes != NULL) { return; }
 
-        // Compare all the pixels in the glyph to all the pixels in the mask
-        i32 matches = 0; 
+    u32 fontCols = font->atlasWidth / font->charWidth;
+    u32 fontRows = font->atlasHeight / font->charHeight;
+    font->glyphCount = fontCols * fontRows;
+    if (font->glyphCount > 256) { font->glyphCount = 256; }
+    font->glyphShapes = calloc(font->glyphCount, sizeof(GlyphShape));
+
+    for (u32 g = 0; g < font->glyphCount; g++) {
+        GlyphShape *shape = &font->glyphShapes[g];
+        u32 glyphOffset = ((g / fontCols) * font->charHeight * font->atlasWidth) + 
+                          ((g % fontCols) * font->charWidth);
+        u32 bit = 0;
         for (u32 y = 0; y < font->charHeight; y++) {
             for (u32 x = 0; x < font->charWidth; x++) {
-                u32 glyphPixel = font->atlas[((cellY * font->charHeight + y) * font->atlasWidth) + (cellX * font->charWidth) + x];
-                u32 maskPixel = maskImage->pixels[y * font->charWidth + x];
-
-                if (glyphPixel == maskPixel) { 
-                    matches += 1; 
-                } else {
-                    matches -= 1;
+                // Colorized fonts are fully foreground wherever they're fully 
+                // covered, others only where they're white
+                u32 i = glyphOffset + (y * font->atlasWidth) + x;
+                bool isForeground = font->colorize ? (font->coverage[i] == 255) : 
+                                                     (font->atlas[i] == 0xFFFFFFFF);
+                if (isForeground) {
+                    shape->bits[bit / 64] |= (u64)1 << (bit % 64);
                 }
+                bit += 1;
             }
         }
+    }
+}
+
+internal u32
+popcount64(u64 x) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (u32)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+internal asciiChar
+image_match_glyph(ConsoleFont *font, GlyphShape *mask) {
+    // Every pixel that agrees with the mask scores a point, and every pixel
+    // that doesn't loses one. The best glyph has the fewest differing bits.
+    i32 pixelCount = font->charWidth * font->charHeight;
+    i32 matchCount = 0;
+    asciiChar bestMatch = 0;
+
+    for (u32 g = 0; g < font->glyphCount; g++) {
+        GlyphShape *shape = &font->glyphShapes[g];
+        i32 mismatches = 0;
+        for (u32 w = 0; w < GLYPH_SHAPE_WORDS; w++) {
+            mismatches += popcount64(shape->bits[w] ^ mask->bits[w]);
+        }
 
+        i32 matches = pixelCount - (2 * mismatches);
         if (matches > matchCount) {
             matchCount = matches;
-            bestMatch = drawingGlyphs[dgi];
+            bestMatch = (asciiChar)g;
         }
     }
 
@@ -655,8 +1675,13 @@ view_new(UIRect pixelRect, u32 cellCountX, u32 cellCountY,
     UIRect *rect = calloc(1, sizeof(UIRect));
 
     memcpy(rect, &pixelRect, sizeof(UIRect));
+    // Views draw straight into their part of the framebuffer, once there is one
+    u32 *pixels = NULL;
+    if (framebuffer.pixels != NULL) {
+        pixels = &framebuffer.pixels[(rect->y * framebuffer.width) + rect->x];
+    }
     Console *console = console_new(rect->w, rect->h, cellCountY, cellCountX, 
-        bgColor, colorize);
+        bgColor, colorize, pixels, framebuffer.width);
 
     i32 cellWidthPixels = pixelRect.w / cellCountX;
     i32 cellHeightPixels = pixelRect.h / cellCountY;
@@ -665,15 +1690,28 @@ view_new(UIRect pixelRect, u32 cellCountX, u32 cellCountY,
     view->console = console;
     view->pixelRect = rect;
     view->render = renderFn;
+    view->onDemand = false;
+    view->dirty = true;
+    view->hidden = false;
 
     return view;
 }
 
-internal void 
-view_destroy(UIView *view) {
-    if (view) {
-        free(view->pixelRect);
-        console_destroy(view->console);
+internal void
+view_mark_dirty(UIView *view) {
+    if (view) { 
+        view->dirty = true; 
+        ui_request_redraw();
+    }
+}
+
+internal void
+view_set_hidden(UIView *view, bool hidden) {
+    // Whatever was under (or over) the view needs redrawing now
+    if (view->hidden != hidden) {
+        view->hidden = hidden;
+        view->dirty = true;
+        ui_damage(view->pixelRect);
     }
 }
 
@@ -729,13 +1767,15 @@ view_draw_rect(Console *console, UIRect *rect, u32 color,
 
 internal void
 view_draw_image_at(Console *console, BitmapImage *image, i32 cellX, i32 cellY) {
-    // Loop through all the pixels in the bitmap, one row at a time and write them into 
-    // the console's pixel buffer at the proper location.
-    u32 dstX = cellX * console->cellWidth;
-    for (u32 srcY = 0; srcY < image->height; srcY++) {
-        // Copy row of pixels from image to console
-        u32 dstY = (cellY * console->cellHeight) + srcY;
-        memcpy(&console->pixels[(dstY * console->width) + dstX], &image->pixels[srcY * image->width], image->width * sizeof(u32));
+    // Point each cell the image covers at its slice of the bitmap. The pixels
+    // themselves are copied into the console when the cell is rasterized.
+    u32 cellsWide = (image->width + console->cellWidth - 1) / console->cellWidth;
+    u32 cellsHigh = (image->height + console->cellHeight - 1) / console->cellHeight;
+    for (u32 y = 0; y < cellsHigh; y++) {
+        for (u32 x = 0; x < cellsWide; x++) {
+            console_put_image_cell_at(console, image, x * console->cellWidth, y * console->cellHeight, 
+                                      cellX + x, cellY + y);
+        }
     }
 }
 
@@ -752,6 +1792,346 @@ view_draw_ascii_image_at(Console *console, AsciiImage *image, i32 cellX, i32 cel
 
 /* Utility Function Implementation */
 
+/* Blend Kernels */
+
+// All kernels blend in 8-bit fixed point. Divisions by 255 are rounded 
+// with (t + (t >> 8)) >> 8 where t = x + 128, which is exact for x <= 255*255.
+#define DIV_255(x) ((((x) + 128) + (((x) + 128) >> 8)) >> 8)
+
+internal inline u32
+ui_blend_pixel(u32 destColor, u32 srcColor)
+{
+    u32 srcA = ALPHA(srcColor);
+    u32 destA = ALPHA(destColor);
+
+    if (srcA == 0) {
+        // Source is transparent - so do nothing
+        return destColor;
+    } else if ((srcA == 255) || (destA == 0)) {
+        // Nothing underneath shows through
+        return srcColor;
+    }
+
+    u32 invSrcA = 255 - srcA;
+    if (destA == 255) {
+        // Opaque destination - the result is opaque too, so no divide needed
+        u32 r = DIV_255((RED(srcColor) * srcA) + (RED(destColor) * invSrcA));
+        u32 g = DIV_255((GREEN(srcColor) * srcA) + (GREEN(destColor) * invSrcA));
+        u32 b = DIV_255((BLUE(srcColor) * srcA) + (BLUE(destColor) * invSrcA));
+        return COLOR_FROM_RGBA(r, g, b, 255u);
+    }
+
+    // General case - weights are scaled by 255 * 255
+    u32 srcW = srcA * 255;
+    u32 destW = destA * invSrcA;
+    u32 outW = srcW + destW;
+    u32 half = outW / 2;
+    u32 r = ((RED(srcColor) * srcW) + (RED(destColor) * destW) + half) / outW;
+    u32 g = ((GREEN(srcColor) * srcW) + (GREEN(destColor) * destW) + half) / outW;
+    u32 b = ((BLUE(srcColor) * srcW) + (BLUE(destColor) * destW) + half) / outW;
+    u32 a = DIV_255(outW);
+    return COLOR_FROM_RGBA(r, g, b, a);
+}
+
+internal void
+ui_blend_span_scalar(u32 *dest, u32 *src, u32 count)
+{
+    for (u32 i = 0; i < count; i++) {
+        dest[i] = ui_blend_pixel(dest[i], src[i]);
+    }
+}
+
+internal void
+ui_blend_coverage_scalar(u32 *dest, u8 *coverage, u32 color, u32 count)
+{
+    for (u32 i = 0; i < count; i++) {
+        // Uncovered pixels leave the destination as it is
+        if (coverage[i] > 0) {
+            dest[i] = ui_blend_pixel(dest[i], ui_colorize_pixel(coverage[i], color));
+        }
+    }
+}
+
+#ifdef UI_BLEND_X86
+
+// The vector kernels handle runs where every destination pixel is either 
+// fully opaque or fully transparent, which is nearly always the case for 
+// consoles. Anything else drops down to ui_blend_pixel.
+
+internal UI_TARGET_SSE2 void
+ui_blend_span_sse2(u32 *dest, u32 *src, u32 count)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i alphaMask = _mm_set1_epi32(0xff);
+    __m128i full = _mm_set1_epi16(255);
+    __m128i round = _mm_set1_epi16(128);
+
+    u32 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i d = _mm_loadu_si128((__m128i *)&dest[i]);
+        __m128i s = _mm_loadu_si128((__m128i *)&src[i]);
+
+        __m128i destA = _mm_and_si128(d, alphaMask);
+        __m128i opaque = _mm_cmpeq_epi32(destA, alphaMask);
+        __m128i clear = _mm_cmpeq_epi32(destA, zero);
+        if (_mm_movemask_epi8(_mm_or_si128(opaque, clear)) != 0xffff) {
+            ui_blend_span_scalar(&dest[i], &src[i], 4);
+            continue;
+        }
+
+        // Widen to 16 bits per channel, two pixels per register, and 
+        // broadcast each pixel's alpha (lowest channel) across its channels
+        __m128i sLo = _mm_unpacklo_epi8(s, zero);
+        __m128i sHi = _mm_unpackhi_epi8(s, zero);
+        __m128i dLo = _mm_unpacklo_epi8(d, zero);
+        __m128i dHi = _mm_unpackhi_epi8(d, zero);
+        __m128i aLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sLo, 0x00), 0x00);
+        __m128i aHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sHi, 0x00), 0x00);
+
+        __m128i tLo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(sLo, aLo), 
+                                                  _mm_mullo_epi16(dLo, _mm_sub_epi16(full, aLo))), 
+                                    round);
+        __m128i tHi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(sHi, aHi), 
+                                                  _mm_mullo_epi16(dHi, _mm_sub_epi16(full, aHi))), 
+                                    round);
+        tLo = _mm_srli_epi16(_mm_add_epi16(tLo, _mm_srli_epi16(tLo, 8)), 8);
+        tHi = _mm_srli_epi16(_mm_add_epi16(tHi, _mm_srli_epi16(tHi, 8)), 8);
+        __m128i blended = _mm_or_si128(_mm_packus_epi16(tLo, tHi), alphaMask);
+
+        // Over a transparent pixel the source is taken as is, unless it is 
+        // transparent too, in which case the pixel is left alone
+        __m128i srcClear = _mm_cmpeq_epi32(_mm_and_si128(s, alphaMask), zero);
+        __m128i takeSrc = _mm_andnot_si128(srcClear, clear);
+        __m128i takeDest = _mm_and_si128(srcClear, clear);
+        __m128i out = _mm_or_si128(_mm_and_si128(blended, opaque),
+                                   _mm_or_si128(_mm_and_si128(s, takeSrc), 
+                                                _mm_and_si128(d, takeDest)));
+        _mm_storeu_si128((__m128i *)&dest[i], out);
+    }
+
+    ui_blend_span_scalar(&dest[i], &src[i], count - i);
+}
+
+internal UI_TARGET_SSE2 void
+ui_blend_coverage_sse2(u32 *dest, u8 *coverage, u32 color, u32 count)
+{
+    // Glyph rows are mostly all uncovered or all covered, which only need 
+    // skipping or filling when the color is opaque. Mixed runs go through 
+    // the scalar kernel.
+    __m128i zero = _mm_setzero_si128();
+    __m128i full = _mm_set1_epi8((char)0xff);
+    __m128i fill = _mm_set1_epi32((int)color);
+    bool opaque = (ALPHA(color) == 255);
+
+    u32 i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i c = _mm_loadu_si128((__m128i *)&coverage[i]);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(c, zero)) == 0xffff) {
+            continue;
+        }
+        if (opaque && (_mm_movemask_epi8(_mm_cmpeq_epi8(c, full)) == 0xffff)) {
+            _mm_storeu_si128((__m128i *)&dest[i], fill);
+            _mm_storeu_si128((__m128i *)&dest[i + 4], fill);
+            _mm_storeu_si128((__m128i *)&dest[i + 8], fill);
+            _mm_storeu_si128((__m128i *)&dest[i + 12], fill);
+            continue;
+        }
+        ui_blend_coverage_scalar(&dest[i], &coverage[i], color, 16);
+    }
+
+    ui_blend_coverage_scalar(&dest[i], &coverage[i], color, count - i);
+}
+
+internal UI_TARGET_AVX2 void
+ui_blend_span_avx2(u32 *dest, u32 *src, u32 count)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i alphaMask = _mm256_set1_epi32(0xff);
+    __m256i full = _mm256_set1_epi16(255);
+    __m256i round = _mm256_set1_epi16(128);
+
+    // Same as the SSE2 kernel, 8 pixels at a time. The unpack and pack 
+    // instructions work within 128-bit lanes, so pixel order is preserved.
+    u32 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i d = _mm256_loadu_si256((__m256i *)&dest[i]);
+        __m256i s = _mm256_loadu_si256((__m256i *)&src[i]);
+
+        __m256i destA = _mm256_and_si256(d, alphaMask);
+        __m256i opaque = _mm256_cmpeq_epi32(destA, alphaMask);
+        __m256i clear = _mm256_cmpeq_epi32(destA, zero);
+        if (_mm256_movemask_epi8(_mm256_or_si256(opaque, clear)) != -1) {
+            ui_blend_span_scalar(&dest[i], &src[i], 8);
+            continue;
+        }
+
+        __m256i sLo = _mm256_unpacklo_epi8(s, zero);
+        __m256i sHi = _mm256_unpackhi_epi8(s, zero);
+        __m256i dLo = _mm256_unpacklo_epi8(d, zero);
+        __m256i dHi = _mm256_unpackhi_epi8(d, zero);
+        __m256i aLo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sLo, 0x00), 0x00);
+        __m256i aHi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sHi, 0x00), 0x00);
+
+        __m256i tLo = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(sLo, aLo), 
+                                                        _mm256_mullo_epi16(dLo, _mm256_sub_epi16(full, aLo))), 
+                                       round);
+        __m256i tHi = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(sHi, aHi), 
+                                                        _mm256_mullo_epi16(dHi, _mm256_sub_epi16(full, aHi))), 
+                                       round);
+        tLo = _mm256_srli_epi16(_mm256_add_epi16(tLo, _mm256_srli_epi16(tLo, 8)), 8);
+        tHi = _mm256_srli_epi16(_mm256_add_epi16(tHi, _mm256_srli_epi16(tHi, 8)), 8);
+        __m256i blended = _mm256_or_si256(_mm256_packus_epi16(tLo, tHi), alphaMask);
+
+        __m256i srcClear = _mm256_cmpeq_epi32(_mm256_and_si256(s, alphaMask), zero);
+        __m256i takeSrc = _mm256_andnot_si256(srcClear, clear);
+        __m256i takeDest = _mm256_and_si256(srcClear, clear);
+        __m256i out = _mm256_or_si256(_mm256_and_si256(blended, opaque),
+                                      _mm256_or_si256(_mm256_and_si256(s, takeSrc), 
+                                                      _mm256_and_si256(d, takeDest)));
+        _mm256_storeu_si256((__m256i *)&dest[i], out);
+    }
+
+    ui_blend_span_sse2(&dest[i], &src[i], count - i);
+}
+
+#endif
+
+#ifdef DEBUG
+
+internal u32
+ui_blend_pixel_float(u32 destColor, u32 srcColor)
+{
+    // The original floating point blend, kept as the reference the 
+    // fixed point kernels are checked against
+    if (ALPHA(srcColor) == 0) {
+        return destColor;
+    } else if (ALPHA(srcColor) == 255) {
+        return srcColor;
+    }
+
+    float srcA = ALPHA(srcColor) / 255.0;
+    float invSrcA = (1.0 - srcA);
+    float destA = ALPHA(destColor) / 255.0;
+
+    float outAlpha = srcA + (destA * invSrcA);
+    u8 fRed = ((RED(srcColor) * srcA) + (RED(destColor) * destA * invSrcA)) / outAlpha;
+    u8 fGreen = ((GREEN(srcColor) * srcA) + (GREEN(destColor) * destA * invSrcA)) / outAlpha;
+    u8 fBlue = ((BLUE(srcColor) * srcA) + (BLUE(destColor) * destA * invSrcA)) / outAlpha;
+    u8 fAlpha = outAlpha * 255;
+
+    return COLOR_FROM_RGBA(fRed, fGreen, fBlue, fAlpha);
+}
+
+internal bool
+ui_blend_within_one(u32 a, u32 b)
+{
+    for (u32 shift = 0; shift < 32; shift += 8) {
+        i32 diff = (i32)((a >> shift) & 0xff) - (i32)((b >> shift) & 0xff);
+        if ((diff < -1) || (diff > 1)) { return false; }
+    }
+    return true;
+}
+
+internal bool
+ui_blend_coverage_conformance_check(UIBlendCoverageFn blendCoverage)
+{
+    // Coverage kernels have to match the scalar one exactly, for every 
+    // coverage over a spread of colors and destinations
+    u32 seed = 0x9e3779b9;
+    u32 dest[BLEND_SPAN_MAX];
+    u32 expected[BLEND_SPAN_MAX];
+    u8 coverage[BLEND_SPAN_MAX];
+
+    for (u32 run = 0; run < 1024; run++) {
+        seed = (seed * 1664525) + 1013904223;
+        u32 color = (run & 1) ? (seed | 0xff) : seed;
+        for (u32 i = 0; i < BLEND_SPAN_MAX; i++) {
+            seed = (seed * 1664525) + 1013904223;
+            dest[i] = expected[i] = (seed & 0xffffff00) | ((i & 4) ? 0xff : (seed >> 24));
+            // Runs of none, full and mixed coverage
+            u32 kind = (run + (i / 16)) % 3;
+            coverage[i] = (kind == 0) ? 0 : ((kind == 1) ? 255 : (u8)(seed >> 16));
+        }
+
+        ui_blend_coverage_scalar(expected, coverage, color, BLEND_SPAN_MAX);
+        blendCoverage(dest, coverage, color, BLEND_SPAN_MAX);
+        if (memcmp(dest, expected, sizeof(dest)) != 0) { return false; }
+    }
+    return true;
+}
+
+internal bool
+ui_blend_conformance_check(UIBlendSpanFn blendSpan)
+{
+    // Run every source alpha against a spread of destination alphas and 
+    // pseudo-random colors, and make sure the kernel never strays more 
+    // than 1 LSB per channel from the float path.
+    local_persist u8 destAlphas[] = {0, 1, 2, 64, 127, 128, 200, 254, 255};
+    u32 seed = 0x2545f491;
+    u32 dest[BLEND_SPAN_MAX];
+    u32 src[BLEND_SPAN_MAX];
+    u32 expected[BLEND_SPAN_MAX];
+
+    for (u32 srcA = 0; srcA < 256; srcA++) {
+        for (u32 d = 0; d < (sizeof(destAlphas) / sizeof(destAlphas[0])); d++) {
+            for (u32 i = 0; i < BLEND_SPAN_MAX; i++) {
+                seed = (seed * 1664525) + 1013904223;
+                src[i] = (seed & 0xffffff00) | srcA;
+                seed = (seed * 1664525) + 1013904223;
+                // Mix in some pixels of other alphas so the vector kernels 
+                // see both uniform and mixed runs
+                dest[i] = (seed & 0xffffff00) | ((i & 8) ? destAlphas[d] : destAlphas[i % 9]);
+                expected[i] = ui_blend_pixel_float(dest[i], src[i]);
+            }
+
+            blendSpan(dest, src, BLEND_SPAN_MAX);
+            for (u32 i = 0; i < BLEND_SPAN_MAX; i++) {
+                if (!ui_blend_within_one(dest[i], expected[i])) { return false; }
+            }
+        }
+    }
+    return true;
+}
+
+internal bool
+ui_blend_self_test()
+{
+    // Check every kernel this CPU can run, not just the ones picked
+    bool passed = true;
+    passed = self_test_report("blend span, scalar", ui_blend_conformance_check(ui_blend_span_scalar)) && passed;
+#ifdef UI_BLEND_X86
+    if (SDL_HasSSE2()) {
+        passed = self_test_report("blend span, SSE2", ui_blend_conformance_check(ui_blend_span_sse2)) && passed;
+        passed = self_test_report("blend coverage, SSE2", ui_blend_coverage_conformance_check(ui_blend_coverage_sse2)) && passed;
+    }
+    if (SDL_HasAVX2()) {
+        passed = self_test_report("blend span, AVX2", ui_blend_conformance_check(ui_blend_span_avx2)) && passed;
+    }
+#endif
+    return passed;
+}
+
+#endif
+
+internal void
+ui_blend_init()
+{
+    // Pick the widest blend kernel this CPU supports
+    ui_blend_span = ui_blend_span_scalar;
+    ui_blend_coverage = ui_blend_coverage_scalar;
+#ifdef UI_BLEND_X86
+    if (SDL_HasAVX2()) {
+        ui_blend_span = ui_blend_span_avx2;
+    } else if (SDL_HasSSE2()) {
+        ui_blend_span = ui_blend_span_sse2;
+    }
+    if (SDL_HasSSE2()) {
+        ui_blend_coverage = ui_blend_coverage_sse2;
+    }
+#endif
+}
+
+
 internal inline u32
 ui_colorize_pixel(u32 dest, u32 src) 
 {
@@ -772,7 +2152,7 @@ ui_colorize_pixel(u32 dest, u32 src)
 internal void
 ui_copy_blend(u32 *destPixels, UIRect *destRect, u32 destPixelsPerRow,
               u32 *srcPixels, UIRect *srcRect, u32 srcPixelsPerRow,
-              bool colorize, u32 *newColor)
+              u32 *newColor)
 {
     // If src and dest rects are not the same size ==> bad things
     assert(destRect->w == srcRect->w && destRect->h == srcRect->h);
@@ -781,60 +2161,67 @@ ui_copy_blend(u32 *destPixels, UIRect *destRect, u32 destPixelsPerRow,
     // corresponding pixel in the source rect.
     // ref: https://en.wikipedia.org/wiki/Alpha_compositing
 
-    u32 stopX = destRect->x + destRect->w;
-    u32 stopY = destRect->y + destRect->h;
+    u32 span[BLEND_SPAN_MAX];
+
+    for (u32 row = 0; row < (u32)destRect->h; row++) {
+        u32 *destRow = &destPixels[((destRect->y + row) * destPixelsPerRow) + destRect->x];
+        u32 *srcRow = &srcPixels[((srcRect->y + row) * srcPixelsPerRow) + srcRect->x];
+
+        for (u32 x = 0; x < (u32)destRect->w; x += BLEND_SPAN_MAX) {
+            u32 count = destRect->w - x;
+            if (count > BLEND_SPAN_MAX) { count = BLEND_SPAN_MAX; }
+
+            for (u32 i = 0; i < count; i++) {
+                u32 srcColor = srcRow[x + i];
 
-    for (u32 dstY = destRect->y, srcY = srcRect->y; 
-         dstY < stopY; 
-         dstY++, srcY++) {
-        for (u32 dstX = destRect->x, srcX = srcRect->x; 
-             dstX < stopX; 
-             dstX++, srcX++) {
-
-            u32 srcColor = srcPixels[(srcY * srcPixelsPerRow) + srcX];
-            u32 *destPixel = &destPixels[(dstY * destPixelsPerRow) + dstX];
-            u32 destColor = *destPixel;
-
-            // If source pixel is true black (0,0,0,255) then treat it as alpha = 0
-            if ((RED(srcColor) == 0) && (GREEN(srcColor) == 0) && 
-                (BLUE(srcColor) == 0) && (ALPHA(srcColor) == 255)) {
-                    srcColor = COLOR_FROM_RGBA(RED(srcColor), GREEN(srcColor), BLUE(srcColor), 0);
+                // If source pixel is true black (0,0,0,255) then treat it as alpha = 0
+                if (srcColor == 0x000000ff) {
+                    srcColor = 0x00000000;
                 }
 
-            // Colorize our source pixel before we blend it
-            if (colorize) {
-                srcColor = ui_colorize_pixel(srcColor, *newColor);
-            } else {
                 // Just apply the alpha value from the newColor, unless the src is transparent
                 if (ALPHA(srcColor) > 0) {
-                    srcColor = COLOR_FROM_RGBA(RED(srcColor), GREEN(srcColor), BLUE(srcColor), ALPHA(*newColor));
+                    srcColor = (srcColor & 0xffffff00) | ALPHA(*newColor);
                 }
+                span[i] = srcColor;
             }
 
-            if (ALPHA(srcColor) == 0) {
-                // Source is transparent - so do nothing
-                continue;
-            } else if (ALPHA(srcColor) == 255) {
-                // Just copy the color, no blending necessary
-                *destPixel = srcColor;
-            } else {
-                // Do alpha blending
-                float srcA = ALPHA(srcColor) / 255.0;
-                float invSrcA = (1.0 - srcA);
-                float destA = ALPHA(destColor) / 255.0;
-
-                float outAlpha = srcA + (destA * invSrcA);
-                u8 fRed = ((RED(srcColor) * srcA) + (RED(destColor) * destA * invSrcA)) / outAlpha;
-                u8 fGreen = ((GREEN(srcColor) * srcA) + (GREEN(destColor) * destA * invSrcA)) / outAlpha;
-                u8 fBlue = ((BLUE(srcColor) * srcA) + (BLUE(destColor) * destA * invSrcA)) / outAlpha;
-                u8 fAlpha = outAlpha * 255;
-
-                *destPixel = COLOR_FROM_RGBA(fRed, fGreen, fBlue, fAlpha);
-            }
+            ui_blend_span(&destRow[x], span, count);
         }
     }
 }
 
+internal void
+ui_copy_blend_coverage(u32 *destPixels, UIRect *destRect, u32 destPixelsPerRow,
+                       u8 *coverage, UIRect *srcRect, u32 coveragePerRow,
+                       u32 color)
+{
+    // As ui_copy_blend with colorizing, but the source is just how much of 
+    // each pixel the color covers
+    assert(destRect->w == srcRect->w && destRect->h == srcRect->h);
+
+    for (u32 row = 0; row < (u32)destRect->h; row++) {
+        u32 *destRow = &destPixels[((destRect->y + row) * destPixelsPerRow) + destRect->x];
+        u8 *srcRow = &coverage[((srcRect->y + row) * coveragePerRow) + srcRect->x];
+        ui_blend_coverage(destRow, srcRow, color, destRect->w);
+    }
+}
+
+internal void
+font_blend_glyph(ConsoleFont *font, asciiChar glyph, u32 fgColor,
+                 u32 *destPixels, UIRect *destRect, u32 destPixelsPerRow)
+{
+    // Blend a glyph into destRect, colorized if the font is
+    UIRect srcRect = rect_get_for_glyph(glyph, font);
+    if (font->colorize) {
+        ui_copy_blend_coverage(destPixels, destRect, destPixelsPerRow,
+                               font->coverage, &srcRect, font->atlasWidth, fgColor);
+    } else {
+        ui_copy_blend(destPixels, destRect, destPixelsPerRow,
+                      font->atlas, &srcRect, font->atlasWidth, &fgColor);
+    }
+}
+
 internal void
 ui_fill(u32 *pixels, u32 pixelsPerRow, UIRect *destRect, u32 color)
 {
@@ -855,37 +2242,28 @@ ui_fill_blend(u32 *pixels, u32 pixelsPerRow, UIRect *destRect, u32 color)
     // bgColor to the existing color.
     // ref: https://en.wikipedia.org/wiki/Alpha_compositing
 
-    u32 stopX = destRect->x + destRect->w;
-    u32 stopY = destRect->y + destRect->h;
-
     // If the color we're trying to blend is transparent, then bail
     if (ALPHA(color) == 0) return;
 
-    float srcA = ALPHA(color) / 255.0;
-    float invSrcA = 1.0 - srcA;
+    // Just copy the color, no blending necessary
+    if (ALPHA(color) == 255) {
+        ui_fill(pixels, pixelsPerRow, destRect, color);
+        return;
+    }
 
     // Otherwise, blend each pixel in the dest rect
-    for (u32 dstY = destRect->y; dstY < stopY; dstY++) {
-        for (u32 dstX = destRect->x; dstX < stopX; dstX++) {
-            u32 *pixel = &pixels[(dstY * pixelsPerRow) + dstX];
-
-            if (ALPHA(color) == 255) {
-                // Just copy the color, no blending necessary
-                *pixel = color;
-            } else {
-                // Do alpha blending
-                u32 pixelColor = *pixel;
-
-                float destA = ALPHA(pixelColor) / 255.0;
-
-                float outAlpha = srcA + (destA * invSrcA);
-                u8 fRed = ((RED(color) * srcA) + (RED(pixelColor) * destA * invSrcA)) / outAlpha;
-                u8 fGreen = ((GREEN(color) * srcA) + (GREEN(pixelColor) * destA * invSrcA)) / outAlpha;
-                u8 fBlue = ((BLUE(color) * srcA) + (BLUE(pixelColor) * destA * invSrcA)) / outAlpha;
-                u8 fAlpha = outAlpha * 255;
+    u32 span[BLEND_SPAN_MAX];
+    u32 spanLength = (destRect->w < BLEND_SPAN_MAX) ? destRect->w : BLEND_SPAN_MAX;
+    for (u32 i = 0; i < spanLength; i++) {
+        span[i] = color;
+    }
 
-                *pixel = COLOR_FROM_RGBA(fRed, fGreen, fBlue, fAlpha);
-            }
+    for (u32 row = 0; row < (u32)destRect->h; row++) {
+        u32 *destRow = &pixels[((destRect->y + row) * pixelsPerRow) + destRect->x];
+        for (u32 x = 0; x < (u32)destRect->w; x += spanLength) {
+            u32 count = destRect->w - x;
+            if (count > spanLength) { count = spanLength; }
+            ui_blend_span(&destRow[x], span, count);
         }
     }
 }
@@ -59,3 +59,12 @@ int xtoi(char *hexstring) {
 	return i;
 }
 
+
+
+#ifdef DEBUG
+/* Print the outcome of one --self-test check, and pass it back. */
+bool self_test_report(char *name, bool passed) {
+	printf("%-32s %s\n", name, passed ? "ok" : "FAILED");
+	return passed;
+}
+#endif
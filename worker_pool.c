@@ -0,0 +1,148 @@
+/*
+* worker_pool.c - Small pool of SDL threads for splitting work into tasks
+*/
+
+#define WORKER_THREADS_MAX	16
+
+// A task is run once for each index in [0, count)
+typedef void (*WorkerTaskFn)(void *data, u32 index);
+
+typedef struct {
+	SDL_Thread *threads[WORKER_THREADS_MAX];
+	u32 threadCount;		// includes the calling (main) thread
+	SDL_sem *workReady;
+	SDL_sem *workDone;
+	bool quit;
+
+	// The task currently being run
+	WorkerTaskFn task;
+	void *taskData;
+	u32 taskCount;
+	SDL_atomic_t nextIndex;
+
+	SDL_threadID owner;		// the only thread that may hand out tasks
+} WorkerPool;
+
+global_variable WorkerPool workerPool = {0};
+
+
+internal void
+worker_pool_run_tasks()
+{
+	// Keep grabbing indices until they're all claimed
+	while (true) {
+		u32 idx = (u32)SDL_AtomicAdd(&workerPool.nextIndex, 1);
+		if (idx >= workerPool.taskCount) {
+			break;
+		}
+		workerPool.task(workerPool.taskData, idx);
+	}
+}
+
+internal int
+worker_pool_thread(void *data)
+{
+	(void)data;
+	while (true) {
+		SDL_SemWait(workerPool.workReady);
+		if (workerPool.quit) {
+			break;
+		}
+		worker_pool_run_tasks();
+		SDL_SemPost(workerPool.workDone);
+	}
+
+	return 0;
+}
+
+/*
+Starts the worker threads. threadCount is the total number of threads that
+work on tasks, including the caller of worker_pool_run. Pass 0 to use one
+thread per CPU core, or 1 to run everything serially on the calling thread.
+*/
+internal void
+worker_pool_init(u32 threadCount)
+{
+	if (threadCount == 0) {
+		threadCount = SDL_GetCPUCount();
+	}
+	if (threadCount < 1) { threadCount = 1; }
+	if (threadCount > WORKER_THREADS_MAX) { threadCount = WORKER_THREADS_MAX; }
+
+	workerPool.threadCount = 1;
+	workerPool.quit = false;
+	workerPool.owner = SDL_ThreadID();
+	if (threadCount == 1) {
+		return;
+	}
+
+	workerPool.workReady = SDL_CreateSemaphore(0);
+	workerPool.workDone = SDL_CreateSemaphore(0);
+	for (u32 i = 0; i < threadCount - 1; i++) {
+		SDL_Thread *thread = SDL_CreateThread(worker_pool_thread, "worker", NULL);
+		if (thread == NULL) {
+			break;
+		}
+		workerPool.threads[i] = thread;
+		workerPool.threadCount += 1;
+	}
+}
+
+internal void
+worker_pool_shutdown()
+{
+	u32 workerCount = workerPool.threadCount - 1;
+	workerPool.quit = true;
+	for (u32 i = 0; i < workerCount; i++) {
+		SDL_SemPost(workerPool.workReady);
+	}
+	for (u32 i = 0; i < workerCount; i++) {
+		SDL_WaitThread(workerPool.threads[i], NULL);
+		workerPool.threads[i] = NULL;
+	}
+	if (workerPool.workReady) { SDL_DestroySemaphore(workerPool.workReady); }
+	if (workerPool.workDone) { SDL_DestroySemaphore(workerPool.workDone); }
+	workerPool.workReady = NULL;
+	workerPool.workDone = NULL;
+	workerPool.threadCount = 1;
+}
+
+internal u32
+worker_pool_thread_count()
+{
+	return (workerPool.threadCount > 0) ? workerPool.threadCount : 1;
+}
+
+/*
+Runs task for every index in [0, count) and returns once they have all
+finished. The calling thread works on tasks too. Tasks may run in any order
+and on any thread, so each must only touch data belonging to its index.
+The pool runs one set of tasks at a time, so calls from any thread other
+than the one that started the pool just run the tasks serially.
+*/
+internal void
+worker_pool_run(WorkerTaskFn task, void *data, u32 count)
+{
+	u32 workerCount = worker_pool_thread_count() - 1;
+	if ((workerCount == 0) || (count <= 1) || (SDL_ThreadID() != workerPool.owner)) {
+		for (u32 i = 0; i < count; i++) {
+			task(data, i);
+		}
+		return;
+	}
+
+	workerPool.task = task;
+	workerPool.taskData = data;
+	workerPool.taskCount = count;
+	SDL_AtomicSet(&workerPool.nextIndex, 0);
+
+	// Only wake as many workers as there are tasks left for them
+	if (workerCount > count - 1) { workerCount = count - 1; }
+	for (u32 i = 0; i < workerCount; i++) {
+		SDL_SemPost(workerPool.workReady);
+	}
+	worker_pool_run_tasks();
+	for (u32 i = 0; i < workerCount; i++) {
+		SDL_SemWait(workerPool.workDone);
+	}
+}